@@ -0,0 +1,31 @@
+# Headless tools that link the plugin's shared code (see ../../Tools).
+# Kept out of the Projucer-generated Makefile so re-saving the .jucer
+# doesn't drop them. Usage:
+#
+#   make -f Tools.mk CONFIG=Release
+#   build/ProcessBlockBenchmark --output=before.json
+
+include Makefile
+
+.DEFAULT_GOAL := Tools
+
+TOOLS_SOURCE := ../../Tools
+TOOLS := ProcessBlockBenchmark EncryptionBenchmark GoldenRender
+TOOLS_TARGETS := $(addprefix $(JUCE_OUTDIR)/,$(TOOLS))
+
+.PHONY: Tools
+Tools : $(TOOLS_TARGETS)
+
+$(TOOLS_TARGETS) : $(JUCE_OUTDIR)/% : $(JUCE_OBJDIR)/Tools/%.o $(JUCE_OUTDIR)/$(JUCE_TARGET_SHARED_CODE) $(JUCE_OBJDIR)/execinfo.cmd
+	@echo Linking "JUCECB - $*"
+	-$(V_AT)mkdir -p $(JUCE_OUTDIR)
+	$(V_AT)$(CXX) -o $@ $< $(JUCE_OUTDIR)/$(JUCE_TARGET_SHARED_CODE) $(JUCE_LDFLAGS) $(shell cat $(JUCE_OBJDIR)/execinfo.cmd) $(TARGET_ARCH)
+
+# Each tool is a single Tools/<Name>/<Name>.cpp
+.SECONDEXPANSION:
+$(JUCE_OBJDIR)/Tools/%.o : $(TOOLS_SOURCE)/$$*/$$*.cpp $(TOOLS_SOURCE)/ToolHelpers.h
+	-$(V_AT)mkdir -p $(@D)
+	@echo "Compiling $*"
+	$(V_AT)$(CXX) $(JUCE_CXXFLAGS) $(JUCE_CPPFLAGS_SHARED_CODE) -I../../Source -I$(TOOLS_SOURCE) -o "$@" -c "$<"
+
+-include $(TOOLS_TARGETS:$(JUCE_OUTDIR)/%=$(JUCE_OBJDIR)/Tools/%.d)
@@ -0,0 +1,58 @@
+/*
+ ==============================================================================
+
+ Reusable AES-256-ECB context for encrypting sample data in place.
+
+ ==============================================================================
+ */
+
+#include "EcbCipher.h"
+
+//==============================================================================
+EcbCipher::EcbCipher()
+: context(EVP_CIPHER_CTX_new())
+{
+}
+
+EcbCipher::~EcbCipher()
+{
+    EVP_CIPHER_CTX_free(context);
+}
+
+bool EcbCipher::setKey(const String& key)
+{
+    std::array<uint8_t, keySize> aesKey {};
+    for (int i = 0; i < key.length() && i < keySize; i++) {
+        aesKey[static_cast<size_t>(i)] = static_cast<uint8_t>(key[i]);
+    }
+
+    if (hasKey && aesKey == currentKey) {
+        return true;
+    }
+
+    hasKey = false;
+    if (context == nullptr
+        || EVP_EncryptInit_ex(context, EVP_aes_256_ecb(), nullptr, aesKey.data(), nullptr) != 1) {
+        return false;
+    }
+
+    EVP_CIPHER_CTX_set_padding(context, 0);
+    currentKey = aesKey;
+    hasKey = true;
+    keyVersion++;
+    return true;
+}
+
+bool EcbCipher::encryptInPlace(uint8_t* data, int numBytes) noexcept
+{
+    jassert(numBytes % blockSize == 0);
+
+    if (!hasKey) {
+        return false;
+    }
+
+    // ECB keeps no state between blocks, so the context is reused as is
+    int outputLength = 0;
+    return EVP_EncryptUpdate(context, data, &outputLength, data, numBytes) == 1
+        && outputLength == numBytes;
+}
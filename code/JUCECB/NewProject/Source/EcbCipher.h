@@ -0,0 +1,50 @@
+/*
+ ==============================================================================
+
+ Reusable AES-256-ECB context for encrypting sample data in place.
+
+ The key schedule runs once per key rather than once per buffer: setKey()
+ only re-initialises the OpenSSL context when the key actually changes, and
+ encryptInPlace() can then be called on any number of tiles. Padding is
+ disabled, so every call must cover whole 16-byte blocks.
+
+ ==============================================================================
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <openssl/evp.h>
+
+//==============================================================================
+class EcbCipher
+{
+    public:
+    static constexpr int blockSize = 16;
+    static constexpr int keySize = 32;
+
+    // Tile size for staging sample data: small enough to stay in L2 while
+    // it is converted, encrypted and converted back.
+    static constexpr int tileBytes = 128 * 1024;
+
+    EcbCipher();
+    ~EcbCipher();
+
+    // The first 32 characters of the key text, zero padded. Returns false if
+    // OpenSSL could not set up the context.
+    bool setKey(const String& key);
+
+    // Encrypts numBytes (a multiple of blockSize) in place.
+    bool encryptInPlace(uint8_t* data, int numBytes) noexcept;
+
+    // Changes every time setKey() installs a different key
+    int getKeyVersion() const noexcept { return keyVersion; }
+
+    private:
+    EVP_CIPHER_CTX* context = nullptr;
+    std::array<uint8_t, keySize> currentKey {};
+    bool hasKey = false;
+    int keyVersion = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (EcbCipher)
+};
@@ -0,0 +1,126 @@
+/*
+ ==============================================================================
+
+ Codebook of already encrypted ECB blocks.
+
+ ==============================================================================
+ */
+
+#include "EcbCodebook.h"
+
+//==============================================================================
+EcbCodebook::EcbCodebook()
+{
+    constexpr int maxBlocks = EcbCipher::tileBytes / EcbCipher::blockSize;
+
+    entries.calloc(static_cast<size_t>(numEntries));
+    batch.allocate(static_cast<size_t>(EcbCipher::tileBytes), false);
+    batchEntries.allocate(static_cast<size_t>(maxBlocks), false);
+    blockSources.allocate(static_cast<size_t>(maxBlocks), false);
+}
+
+int EcbCodebook::encryptInPlace(EcbCipher& cipher, uint8_t* data, int numBytes)
+{
+    jassert(numBytes % EcbCipher::blockSize == 0 && numBytes <= EcbCipher::tileBytes);
+
+    // Cached ciphertext is only valid for the key it was made with
+    if (cipher.getKeyVersion() != keyVersion) {
+        clear();
+        keyVersion = cipher.getKeyVersion();
+    }
+
+    const int numBlocks = numBytes / EcbCipher::blockSize;
+
+    if (callsToBypass > 0) {
+        callsToBypass--;
+        return cipher.encryptInPlace(data, numBytes) ? numBlocks : -1;
+    }
+
+    constexpr uint32 mask = numEntries - 1;
+    int batchSize = 0;
+
+    // Look every block up, queueing the ones never seen before
+    for (int block = 0; block < numBlocks; block++) {
+        uint8_t* blockData = data + block * EcbCipher::blockSize;
+        uint64 plaintext[2];
+        memcpy(plaintext, blockData, sizeof(plaintext));
+
+        int32 source = -2; // Still needs a batch slot
+        int32 victim = -1; // First entry that can be replaced if none match
+        const uint32 home = hash(plaintext[0], plaintext[1]);
+
+        for (uint32 probe = 0; probe < static_cast<uint32>(maxProbes); probe++) {
+            const uint32 index = (home + probe) & mask;
+            Entry& entry = entries[index];
+
+            if (entry.generation != generation) {
+                // Empty: claim it for this block
+                entry.plaintext[0] = plaintext[0];
+                entry.plaintext[1] = plaintext[1];
+                entry.generation = generation;
+                entry.pendingIndex = batchSize;
+                batchEntries[batchSize] = static_cast<int32>(index);
+                break;
+            }
+
+            if (entry.plaintext[0] == plaintext[0] && entry.plaintext[1] == plaintext[1]) {
+                if (entry.pendingIndex >= 0) {
+                    source = entry.pendingIndex; // Queued earlier in this call
+                } else {
+                    memcpy(blockData, entry.ciphertext, sizeof(entry.ciphertext));
+                    source = -1;
+                }
+                break;
+            }
+
+            if (victim < 0 && entry.pendingIndex < 0) {
+                victim = static_cast<int32>(index);
+            }
+
+            if (probe == static_cast<uint32>(maxProbes) - 1) {
+                // Neighbourhood full: replace the nearest entry that isn't
+                // waiting for this batch, so new material can still be cached
+                if (victim >= 0) {
+                    Entry& replaced = entries[victim];
+                    replaced.plaintext[0] = plaintext[0];
+                    replaced.plaintext[1] = plaintext[1];
+                    replaced.pendingIndex = batchSize;
+                }
+                batchEntries[batchSize] = victim;
+            }
+        }
+
+        if (source == -2) {
+            memcpy(batch + batchSize * EcbCipher::blockSize, blockData, EcbCipher::blockSize);
+            source = batchSize++;
+        }
+        blockSources[block] = source;
+    }
+
+    // Encrypt the new blocks in one go, then fill the codebook and scatter
+    if (batchSize > 0 && !cipher.encryptInPlace(batch, batchSize * EcbCipher::blockSize)) {
+        clear();
+        return -1;
+    }
+
+    for (int i = 0; i < batchSize; i++) {
+        if (batchEntries[i] >= 0) {
+            Entry& entry = entries[batchEntries[i]];
+            memcpy(entry.ciphertext, batch + i * EcbCipher::blockSize, sizeof(entry.ciphertext));
+            entry.pendingIndex = -1;
+        }
+    }
+
+    for (int block = 0; block < numBlocks; block++) {
+        if (blockSources[block] >= 0) {
+            memcpy(data + block * EcbCipher::blockSize,
+                   batch + blockSources[block] * EcbCipher::blockSize, EcbCipher::blockSize);
+        }
+    }
+
+    if ((numBlocks - batchSize) * minHitRateDivisor < numBlocks) {
+        callsToBypass = bypassCalls;
+    }
+
+    return batchSize;
+}
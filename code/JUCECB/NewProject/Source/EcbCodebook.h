@@ -0,0 +1,75 @@
+/*
+ ==============================================================================
+
+ Codebook of already encrypted ECB blocks.
+
+ After quantization, periodic material repeats the same 16-byte plaintext
+ blocks over and over, and ECB maps each one to the same ciphertext every
+ time. The codebook hashes every block and only sends blocks it hasn't
+ seen to the cipher, in one batch, then copies the cached ciphertext to
+ every other occurrence. The output is identical to encrypting each block.
+
+ Entries stay valid until the cipher's key changes. When all the slots a
+ block can go in are taken, the nearest one is replaced, so the codebook
+ follows new material instead of filling up with the first sample it saw.
+ Material that barely repeats (noise) would only pay for the lookups, so
+ after a call with a low hit rate the next few calls go straight to the
+ cipher.
+
+ ==============================================================================
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "EcbCipher.h"
+
+//==============================================================================
+class EcbCodebook
+{
+    public:
+    static constexpr int numEntries = 4096; // Power of two
+    static constexpr int maxProbes = 8;
+    static constexpr int bypassCalls = 8;       // Calls skipped after a poor hit rate
+    static constexpr int minHitRateDivisor = 16; // Poor means fewer than 1 in 16 hits
+
+    EcbCodebook();
+
+    // Encrypts numBytes (a multiple of EcbCipher::blockSize, at most
+    // EcbCipher::tileBytes) in place. Returns the number of blocks that had
+    // to go through the cipher, or -1 if the cipher failed.
+    int encryptInPlace(EcbCipher& cipher, uint8_t* data, int numBytes);
+
+    void clear() noexcept
+    {
+        generation++;
+        callsToBypass = 0;
+    }
+
+    private:
+    struct Entry
+    {
+        uint64 plaintext[2];
+        uint64 ciphertext[2];
+        uint32 generation;  // Entry is empty unless this matches the codebook's
+        int32 pendingIndex; // Index in the current batch while not yet encrypted
+    };
+
+    static uint32 hash(uint64 low, uint64 high) noexcept
+    {
+        uint64 h = (low ^ (high * 0x9e3779b97f4a7c15ULL)) * 0xff51afd7ed558ccdULL;
+        return static_cast<uint32>(h >> 32);
+    }
+
+    HeapBlock<Entry> entries;
+    uint32 generation = 1;
+    int keyVersion = -1;
+    int callsToBypass = 0;
+
+    // Per-call scratch
+    HeapBlock<uint8_t> batch;       // Blocks sent to the cipher
+    HeapBlock<int32> batchEntries;  // Entry each batched block fills, or -1
+    HeapBlock<int32> blockSources;  // Batch index each block copies from, or -1 once written
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (EcbCodebook)
+};
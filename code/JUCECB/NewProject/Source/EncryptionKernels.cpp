@@ -0,0 +1,481 @@
+/*
+ ==============================================================================
+
+ Fused, vectorised passes around the cipher in encryptAudioECB.
+
+ ==============================================================================
+ */
+
+#include "EncryptionKernels.h"
+
+#if JUCE_INTEL
+ #include <immintrin.h>
+#endif
+
+#if JUCECB_HAS_NEON
+ #include <arm_neon.h>
+#endif
+
+namespace
+{
+    // measure() sums squares into this many interleaved double lanes, sample
+    // i going to lane i % sumLanes, and adds the lanes up in order at the
+    // end. Every implementation uses the same lanes, so they all produce the
+    // same sum.
+    constexpr int sumLanes = 8;
+
+    double addLanes(const double* lanes)
+    {
+        double total = 0.0;
+        for (int lane = 0; lane < sumLanes; lane++) {
+            total += lanes[lane];
+        }
+        return total;
+    }
+
+    //==============================================================================
+    void measureTail(const float* data, int start, int numSamples, double* lanes, float& peak)
+    {
+        for (int i = start; i < numSamples; i++) {
+            lanes[i % sumLanes] += data[i] * data[i];
+            peak = std::max(peak, std::abs(data[i]));
+        }
+    }
+
+    // With an odd number of levels the peak can round up to a level just
+    // past 0.95, which doesn't fit in int16. It has always wrapped around
+    // rather than saturating, and every implementation keeps doing so.
+    int16_t quantizeSample(float sample, float normalizeScale, float quantizationStep)
+    {
+        const float clampedInput = std::max(-0.95f, std::min(0.95f, sample * normalizeScale));
+        const float level = std::round(clampedInput / quantizationStep);
+        const auto value = static_cast<int32_t>(std::round(level * quantizationStep * EncryptionKernels::int16Scale));
+        return static_cast<int16_t>(static_cast<uint16_t>(value));
+    }
+
+    void quantizeTail(const float* source, int start, int numSamples, float normalizeScale,
+                      float quantizationStep, int16_t* dest)
+    {
+        for (int i = start; i < numSamples; i++) {
+            dest[i] = quantizeSample(source[i], normalizeScale, quantizationStep);
+        }
+    }
+
+    juce::int64 convertTail(const int16_t* source, int start, int numSamples, float* dest)
+    {
+        juce::int64 sumOfSquares = 0;
+        for (int i = start; i < numSamples; i++) {
+            dest[i] = static_cast<float>(source[i]) / EncryptionKernels::int16Scale;
+            sumOfSquares += static_cast<juce::int64>(source[i]) * source[i];
+        }
+        return sumOfSquares;
+    }
+
+    void gainTail(float* data, int start, int numSamples, float gain)
+    {
+        for (int i = start; i < numSamples; i++) {
+            data[i] = std::max(-1.0f, std::min(1.0f, data[i] * gain));
+        }
+    }
+
+    //==============================================================================
+    void measureScalar(const float* data, int numSamples, double& sumOfSquares, float& peak)
+    {
+        double lanes[sumLanes] = {};
+        measureTail(data, 0, numSamples, lanes, peak);
+        sumOfSquares += addLanes(lanes);
+    }
+
+    void quantizeScalar(const float* source, int numSamples, float normalizeScale,
+                        float quantizationStep, int16_t* dest)
+    {
+        quantizeTail(source, 0, numSamples, normalizeScale, quantizationStep, dest);
+    }
+
+    juce::int64 convertScalar(const int16_t* source, int numSamples, float* dest)
+    {
+        return convertTail(source, 0, numSamples, dest);
+    }
+
+    void gainScalar(float* data, int numSamples, float gain)
+    {
+        gainTail(data, 0, numSamples, gain);
+    }
+
+    const EncryptionKernels::Table scalarTable { measureScalar, quantizeScalar, convertScalar, gainScalar };
+
+#if JUCE_INTEL
+    //==============================================================================
+    // std::round for |v| < 2^23: truncate, then step away from zero if the
+    // (exact) fractional part is at least a half
+    inline __m128 roundSSE2(__m128 v)
+    {
+        const __m128 signMask = _mm_set1_ps(-0.0f);
+        const __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(v));
+        const __m128 fraction = _mm_andnot_ps(signMask, _mm_sub_ps(v, truncated));
+        const __m128 away = _mm_or_ps(_mm_and_ps(v, signMask), _mm_set1_ps(1.0f));
+        return _mm_add_ps(truncated, _mm_and_ps(_mm_cmpge_ps(fraction, _mm_set1_ps(0.5f)), away));
+    }
+
+    inline __m128i quantizeVectorSSE2(__m128 v, __m128 scale, __m128 step, __m128 limit, __m128 int16Scale)
+    {
+        const __m128 clamped = _mm_max_ps(_mm_sub_ps(_mm_setzero_ps(), limit),
+                                          _mm_min_ps(_mm_mul_ps(v, scale), limit));
+        const __m128 level = roundSSE2(_mm_div_ps(clamped, step));
+        const __m128i value = _mm_cvttps_epi32(roundSSE2(_mm_mul_ps(_mm_mul_ps(level, step), int16Scale)));
+
+        // Sign-extend the low 16 bits so the saturating pack wraps like quantizeSample()
+        return _mm_srai_epi32(_mm_slli_epi32(value, 16), 16);
+    }
+
+    void measureSSE2(const float* data, int numSamples, double& sumOfSquares, float& peak)
+    {
+        const __m128 signMask = _mm_set1_ps(-0.0f);
+        __m128d sum0 = _mm_setzero_pd(), sum1 = _mm_setzero_pd();
+        __m128d sum2 = _mm_setzero_pd(), sum3 = _mm_setzero_pd();
+        __m128 peaks = _mm_setzero_ps();
+
+        int i = 0;
+        for (; i + 8 <= numSamples; i += 8) {
+            const __m128 a = _mm_loadu_ps(data + i);
+            const __m128 b = _mm_loadu_ps(data + i + 4);
+            const __m128 squaresA = _mm_mul_ps(a, a);
+            const __m128 squaresB = _mm_mul_ps(b, b);
+
+            sum0 = _mm_add_pd(sum0, _mm_cvtps_pd(squaresA));
+            sum1 = _mm_add_pd(sum1, _mm_cvtps_pd(_mm_movehl_ps(squaresA, squaresA)));
+            sum2 = _mm_add_pd(sum2, _mm_cvtps_pd(squaresB));
+            sum3 = _mm_add_pd(sum3, _mm_cvtps_pd(_mm_movehl_ps(squaresB, squaresB)));
+            peaks = _mm_max_ps(peaks, _mm_max_ps(_mm_andnot_ps(signMask, a), _mm_andnot_ps(signMask, b)));
+        }
+
+        alignas(16) double lanes[sumLanes];
+        _mm_store_pd(lanes, sum0);
+        _mm_store_pd(lanes + 2, sum1);
+        _mm_store_pd(lanes + 4, sum2);
+        _mm_store_pd(lanes + 6, sum3);
+
+        alignas(16) float peakLanes[4];
+        _mm_store_ps(peakLanes, peaks);
+        for (float lanePeak : peakLanes) {
+            peak = std::max(peak, lanePeak);
+        }
+
+        measureTail(data, i, numSamples, lanes, peak);
+        sumOfSquares += addLanes(lanes);
+    }
+
+    void quantizeSSE2(const float* source, int numSamples, float normalizeScale,
+                      float quantizationStep, int16_t* dest)
+    {
+        const __m128 scale = _mm_set1_ps(normalizeScale);
+        const __m128 step = _mm_set1_ps(quantizationStep);
+        const __m128 limit = _mm_set1_ps(0.95f);
+        const __m128 int16Scale = _mm_set1_ps(EncryptionKernels::int16Scale);
+
+        int i = 0;
+        for (; i + 8 <= numSamples; i += 8) {
+            const __m128i low = quantizeVectorSSE2(_mm_loadu_ps(source + i), scale, step, limit, int16Scale);
+            const __m128i high = quantizeVectorSSE2(_mm_loadu_ps(source + i + 4), scale, step, limit, int16Scale);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), _mm_packs_epi32(low, high));
+        }
+
+        quantizeTail(source, i, numSamples, normalizeScale, quantizationStep, dest);
+    }
+
+    juce::int64 convertSSE2(const int16_t* source, int numSamples, float* dest)
+    {
+        const __m128 int16Scale = _mm_set1_ps(EncryptionKernels::int16Scale);
+        __m128i sums = _mm_setzero_si128();
+
+        int i = 0;
+        for (; i + 8 <= numSamples; i += 8) {
+            const __m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+            const __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16);
+            const __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16);
+            _mm_storeu_ps(dest + i, _mm_div_ps(_mm_cvtepi32_ps(low), int16Scale));
+            _mm_storeu_ps(dest + i + 4, _mm_div_ps(_mm_cvtepi32_ps(high), int16Scale));
+
+            // Pairwise sums of squares are at most 2^31, so read them unsigned
+            const __m128i squares = _mm_madd_epi16(samples, samples);
+            sums = _mm_add_epi64(sums, _mm_unpacklo_epi32(squares, _mm_setzero_si128()));
+            sums = _mm_add_epi64(sums, _mm_unpackhi_epi32(squares, _mm_setzero_si128()));
+        }
+
+        alignas(16) juce::int64 sumLanesOut[2];
+        _mm_store_si128(reinterpret_cast<__m128i*>(sumLanesOut), sums);
+        return sumLanesOut[0] + sumLanesOut[1] + convertTail(source, i, numSamples, dest);
+    }
+
+    void gainSSE2(float* data, int numSamples, float gain)
+    {
+        const __m128 gains = _mm_set1_ps(gain);
+        const __m128 upper = _mm_set1_ps(1.0f);
+        const __m128 lower = _mm_set1_ps(-1.0f);
+
+        int i = 0;
+        for (; i + 4 <= numSamples; i += 4) {
+            const __m128 v = _mm_mul_ps(_mm_loadu_ps(data + i), gains);
+            _mm_storeu_ps(data + i, _mm_max_ps(lower, _mm_min_ps(v, upper)));
+        }
+
+        gainTail(data, i, numSamples, gain);
+    }
+
+    const EncryptionKernels::Table sse2Table { measureSSE2, quantizeSSE2, convertSSE2, gainSSE2 };
+
+    //==============================================================================
+    // Rounds v in place like roundSSE2. Works through a reference because
+    // passing __m256 by value to or from an inline helper trips GCC's AVX
+    // ABI warning when the file isn't compiled for AVX.
+    JUCECB_TARGET_AVX2
+    inline void roundAVX2(__m256& v)
+    {
+        const __m256 signMask = _mm256_set1_ps(-0.0f);
+        const __m256 truncated = _mm256_cvtepi32_ps(_mm256_cvttps_epi32(v));
+        const __m256 fraction = _mm256_andnot_ps(signMask, _mm256_sub_ps(v, truncated));
+        const __m256 away = _mm256_or_ps(_mm256_and_ps(v, signMask), _mm256_set1_ps(1.0f));
+        const __m256 roundUp = _mm256_cmp_ps(fraction, _mm256_set1_ps(0.5f), _CMP_GE_OQ);
+        v = _mm256_add_ps(truncated, _mm256_and_ps(roundUp, away));
+    }
+
+    JUCECB_TARGET_AVX2
+    void measureAVX2(const float* data, int numSamples, double& sumOfSquares, float& peak)
+    {
+        const __m256 signMask = _mm256_set1_ps(-0.0f);
+        __m256d sumLow = _mm256_setzero_pd(), sumHigh = _mm256_setzero_pd();
+        __m256 peaks = _mm256_setzero_ps();
+
+        int i = 0;
+        for (; i + 8 <= numSamples; i += 8) {
+            const __m256 v = _mm256_loadu_ps(data + i);
+            const __m256 squares = _mm256_mul_ps(v, v);
+
+            sumLow = _mm256_add_pd(sumLow, _mm256_cvtps_pd(_mm256_castps256_ps128(squares)));
+            sumHigh = _mm256_add_pd(sumHigh, _mm256_cvtps_pd(_mm256_extractf128_ps(squares, 1)));
+            peaks = _mm256_max_ps(peaks, _mm256_andnot_ps(signMask, v));
+        }
+
+        alignas(32) double lanes[sumLanes];
+        _mm256_store_pd(lanes, sumLow);
+        _mm256_store_pd(lanes + 4, sumHigh);
+
+        alignas(32) float peakLanes[8];
+        _mm256_store_ps(peakLanes, peaks);
+        for (float lanePeak : peakLanes) {
+            peak = std::max(peak, lanePeak);
+        }
+
+        measureTail(data, i, numSamples, lanes, peak);
+        sumOfSquares += addLanes(lanes);
+    }
+
+    JUCECB_TARGET_AVX2
+    void quantizeAVX2(const float* source, int numSamples, float normalizeScale,
+                      float quantizationStep, int16_t* dest)
+    {
+        const __m256 scale = _mm256_set1_ps(normalizeScale);
+        const __m256 step = _mm256_set1_ps(quantizationStep);
+        const __m256 upper = _mm256_set1_ps(0.95f);
+        const __m256 lower = _mm256_set1_ps(-0.95f);
+        const __m256 int16Scale = _mm256_set1_ps(EncryptionKernels::int16Scale);
+
+        int i = 0;
+        for (; i + 8 <= numSamples; i += 8) {
+            const __m256 clamped = _mm256_max_ps(lower, _mm256_min_ps(_mm256_mul_ps(_mm256_loadu_ps(source + i), scale), upper));
+            __m256 level = _mm256_div_ps(clamped, step);
+            roundAVX2(level);
+            __m256 scaled = _mm256_mul_ps(_mm256_mul_ps(level, step), int16Scale);
+            roundAVX2(scaled);
+            const __m256i rounded = _mm256_cvttps_epi32(scaled);
+            const __m256i values = _mm256_srai_epi32(_mm256_slli_epi32(rounded, 16), 16); // Wrap, see quantizeSample()
+            const __m128i packed = _mm_packs_epi32(_mm256_castsi256_si128(values), _mm256_extracti128_si256(values, 1));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), packed);
+        }
+
+        quantizeTail(source, i, numSamples, normalizeScale, quantizationStep, dest);
+    }
+
+    JUCECB_TARGET_AVX2
+    juce::int64 convertAVX2(const int16_t* source, int numSamples, float* dest)
+    {
+        const __m256 int16Scale = _mm256_set1_ps(EncryptionKernels::int16Scale);
+        __m256i sums = _mm256_setzero_si256();
+
+        int i = 0;
+        for (; i + 8 <= numSamples; i += 8) {
+            const __m256i samples = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i)));
+            _mm256_storeu_ps(dest + i, _mm256_div_ps(_mm256_cvtepi32_ps(samples), int16Scale));
+
+            // Squares are at most 2^30
+            const __m256i squares = _mm256_mullo_epi32(samples, samples);
+            sums = _mm256_add_epi64(sums, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(squares)));
+            sums = _mm256_add_epi64(sums, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(squares, 1)));
+        }
+
+        alignas(32) juce::int64 sumLanesOut[4];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(sumLanesOut), sums);
+        return sumLanesOut[0] + sumLanesOut[1] + sumLanesOut[2] + sumLanesOut[3]
+             + convertTail(source, i, numSamples, dest);
+    }
+
+    JUCECB_TARGET_AVX2
+    void gainAVX2(float* data, int numSamples, float gain)
+    {
+        const __m256 gains = _mm256_set1_ps(gain);
+        const __m256 upper = _mm256_set1_ps(1.0f);
+        const __m256 lower = _mm256_set1_ps(-1.0f);
+
+        int i = 0;
+        for (; i + 8 <= numSamples; i += 8) {
+            const __m256 v = _mm256_mul_ps(_mm256_loadu_ps(data + i), gains);
+            _mm256_storeu_ps(data + i, _mm256_max_ps(lower, _mm256_min_ps(v, upper)));
+        }
+
+        gainTail(data, i, numSamples, gain);
+    }
+
+    const EncryptionKernels::Table avx2Table { measureAVX2, quantizeAVX2, convertAVX2, gainAVX2 };
+#endif
+
+#if JUCECB_HAS_NEON
+    //==============================================================================
+    inline float32x4_t roundNEON(float32x4_t v)
+    {
+        const float32x4_t truncated = vcvtq_f32_s32(vcvtq_s32_f32(v));
+        const uint32x4_t roundUp = vcgeq_f32(vabsq_f32(vsubq_f32(v, truncated)), vdupq_n_f32(0.5f));
+        const float32x4_t away = vbslq_f32(vdupq_n_u32(0x80000000u), v, vdupq_n_f32(1.0f));
+        return vaddq_f32(truncated, vbslq_f32(roundUp, away, vdupq_n_f32(0.0f)));
+    }
+
+    inline int32x4_t quantizeVectorNEON(float32x4_t v, float32x4_t scale, float32x4_t step, float32x4_t int16Scale)
+    {
+        const float32x4_t clamped = vmaxq_f32(vdupq_n_f32(-0.95f), vminq_f32(vmulq_f32(v, scale), vdupq_n_f32(0.95f)));
+        const float32x4_t level = roundNEON(vdivq_f32(clamped, step));
+        return vcvtq_s32_f32(roundNEON(vmulq_f32(vmulq_f32(level, step), int16Scale)));
+    }
+
+    void measureNEON(const float* data, int numSamples, double& sumOfSquares, float& peak)
+    {
+        float64x2_t sum0 = vdupq_n_f64(0.0), sum1 = vdupq_n_f64(0.0);
+        float64x2_t sum2 = vdupq_n_f64(0.0), sum3 = vdupq_n_f64(0.0);
+        float32x4_t peaks = vdupq_n_f32(0.0f);
+
+        int i = 0;
+        for (; i + 8 <= numSamples; i += 8) {
+            const float32x4_t a = vld1q_f32(data + i);
+            const float32x4_t b = vld1q_f32(data + i + 4);
+            const float32x4_t squaresA = vmulq_f32(a, a);
+            const float32x4_t squaresB = vmulq_f32(b, b);
+
+            sum0 = vaddq_f64(sum0, vcvt_f64_f32(vget_low_f32(squaresA)));
+            sum1 = vaddq_f64(sum1, vcvt_high_f64_f32(squaresA));
+            sum2 = vaddq_f64(sum2, vcvt_f64_f32(vget_low_f32(squaresB)));
+            sum3 = vaddq_f64(sum3, vcvt_high_f64_f32(squaresB));
+            peaks = vmaxq_f32(peaks, vmaxq_f32(vabsq_f32(a), vabsq_f32(b)));
+        }
+
+        double lanes[sumLanes];
+        vst1q_f64(lanes, sum0);
+        vst1q_f64(lanes + 2, sum1);
+        vst1q_f64(lanes + 4, sum2);
+        vst1q_f64(lanes + 6, sum3);
+
+        peak = std::max(peak, vmaxvq_f32(peaks));
+        measureTail(data, i, numSamples, lanes, peak);
+        sumOfSquares += addLanes(lanes);
+    }
+
+    void quantizeNEON(const float* source, int numSamples, float normalizeScale,
+                      float quantizationStep, int16_t* dest)
+    {
+        const float32x4_t scale = vdupq_n_f32(normalizeScale);
+        const float32x4_t step = vdupq_n_f32(quantizationStep);
+        const float32x4_t int16Scale = vdupq_n_f32(EncryptionKernels::int16Scale);
+
+        int i = 0;
+        for (; i + 8 <= numSamples; i += 8) {
+            const int32x4_t low = quantizeVectorNEON(vld1q_f32(source + i), scale, step, int16Scale);
+            const int32x4_t high = quantizeVectorNEON(vld1q_f32(source + i + 4), scale, step, int16Scale);
+            vst1q_s16(dest + i, vcombine_s16(vmovn_s32(low), vmovn_s32(high))); // Wraps, see quantizeSample()
+        }
+
+        quantizeTail(source, i, numSamples, normalizeScale, quantizationStep, dest);
+    }
+
+    juce::int64 convertNEON(const int16_t* source, int numSamples, float* dest)
+    {
+        const float32x4_t int16Scale = vdupq_n_f32(EncryptionKernels::int16Scale);
+        int64x2_t sums = vdupq_n_s64(0);
+
+        int i = 0;
+        for (; i + 8 <= numSamples; i += 8) {
+            const int16x8_t samples = vld1q_s16(source + i);
+            const int16x4_t low = vget_low_s16(samples);
+            const int16x4_t high = vget_high_s16(samples);
+            vst1q_f32(dest + i, vdivq_f32(vcvtq_f32_s32(vmovl_s16(low)), int16Scale));
+            vst1q_f32(dest + i + 4, vdivq_f32(vcvtq_f32_s32(vmovl_s16(high)), int16Scale));
+
+            sums = vpadalq_s32(sums, vmull_s16(low, low));
+            sums = vpadalq_s32(sums, vmull_s16(high, high));
+        }
+
+        return vaddvq_s64(sums) + convertTail(source, i, numSamples, dest);
+    }
+
+    void gainNEON(float* data, int numSamples, float gain)
+    {
+        const float32x4_t upper = vdupq_n_f32(1.0f);
+        const float32x4_t lower = vdupq_n_f32(-1.0f);
+
+        int i = 0;
+        for (; i + 4 <= numSamples; i += 4) {
+            const float32x4_t v = vmulq_n_f32(vld1q_f32(data + i), gain);
+            vst1q_f32(data + i, vmaxq_f32(lower, vminq_f32(v, upper)));
+        }
+
+        gainTail(data, i, numSamples, gain);
+    }
+
+    const EncryptionKernels::Table neonTable { measureNEON, quantizeNEON, convertNEON, gainNEON };
+#endif
+
+    //==============================================================================
+    SimdDispatch::Dispatcher<EncryptionKernels::Table>& getDispatcher()
+    {
+        static SimdDispatch::Dispatcher<EncryptionKernels::Table> dispatcher { [] {
+            SimdDispatch::Tables<EncryptionKernels::Table> tables;
+            tables.scalar = &scalarTable;
+           #if JUCE_INTEL
+            tables.sse2 = &sse2Table;
+            tables.avx2 = &avx2Table;
+           #endif
+           #if JUCECB_HAS_NEON
+            tables.neon = &neonTable;
+           #endif
+            return tables;
+        }() };
+        return dispatcher;
+    }
+}
+
+//==============================================================================
+const EncryptionKernels::Table& EncryptionKernels::kernels()
+{
+    return getDispatcher().get();
+}
+
+bool EncryptionKernels::setImplementation(Implementation implementation)
+{
+    return getDispatcher().set(implementation);
+}
+
+EncryptionKernels::Implementation EncryptionKernels::getImplementation()
+{
+    return getDispatcher().getImplementation();
+}
+
+const char* EncryptionKernels::getImplementationName()
+{
+    return SimdDispatch::getName(getImplementation());
+}
@@ -0,0 +1,74 @@
+/*
+ ==============================================================================
+
+ Fused, vectorised passes around the cipher in encryptAudioECB.
+
+ Before the cipher a single pass normalizes, clamps, quantizes and converts
+ a chunk straight to int16; after it, a single pass converts back to float
+ while measuring the encrypted level. Each pass has SSE2, AVX2 and NEON
+ versions plus a scalar fallback, picked at runtime through SimdDispatch.
+
+ All versions match the scalar pipeline exactly: they divide rather than
+ multiply by reciprocals, and round halves away from zero like std::round.
+
+ ==============================================================================
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "SimdDispatch.h"
+
+//==============================================================================
+struct EncryptionKernels
+{
+    using Implementation = SimdDispatch::Implementation;
+
+    // Quantized samples are scaled to slightly less than the full int16 range
+    static constexpr float int16Scale = 30000.0f;
+
+    // Adds the sum of squares of data to sumOfSquares and raises peak to the
+    // largest magnitude.
+    static void measure(const float* data, int numSamples, double& sumOfSquares, float& peak)
+    {
+        kernels().measure(data, numSamples, sumOfSquares, peak);
+    }
+
+    // dest[i] = round(q(clamp(source[i] * normalizeScale)) * int16Scale), where q
+    // rounds to the nearest multiple of quantizationStep and clamp limits to
+    // +-0.95.
+    static void quantizeToInt16(const float* source, int numSamples, float normalizeScale,
+                                float quantizationStep, int16_t* dest)
+    {
+        kernels().quantizeToInt16(source, numSamples, normalizeScale, quantizationStep, dest);
+    }
+
+    // dest[i] = source[i] / int16Scale. Returns the sum of source[i]^2.
+    static juce::int64 convertFromInt16(const int16_t* source, int numSamples, float* dest)
+    {
+        return kernels().convertFromInt16(source, numSamples, dest);
+    }
+
+    // data[i] = clamp(data[i] * gain) to +-1.
+    static void applyGainAndClip(float* data, int numSamples, float gain)
+    {
+        kernels().applyGainAndClip(data, numSamples, gain);
+    }
+
+    struct Table
+    {
+        void (*measure)(const float*, int, double&, float&);
+        void (*quantizeToInt16)(const float*, int, float, float, int16_t*);
+        juce::int64 (*convertFromInt16)(const int16_t*, int, float*);
+        void (*applyGainAndClip)(float*, int, float);
+    };
+
+    // Forces a specific implementation, e.g. for benchmarks. Returns false
+    // and keeps the current one if the CPU or build doesn't support it.
+    static bool setImplementation(Implementation implementation);
+    static Implementation getImplementation();
+    static const char* getImplementationName();
+
+    private:
+    static const Table& kernels();
+};
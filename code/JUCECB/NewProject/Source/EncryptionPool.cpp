@@ -0,0 +1,152 @@
+/*
+ ==============================================================================
+
+ Thread pool that spreads the encryption stages over fixed-size chunks.
+
+ ==============================================================================
+ */
+
+#include "EncryptionPool.h"
+#include "EncryptionKernels.h"
+#include "Tracing.h"
+
+//==============================================================================
+EncryptionPool::SharedThreads::SharedThreads()
+{
+    // The calling thread of each job works too
+    const int numThreads = jmin(maxThreads, SystemStats::getNumCpus()) - 1;
+    if (numThreads > 0) {
+        pool = std::make_unique<ThreadPool>(ThreadPoolOptions{}.withThreadName("JUCECB Encryption Pool")
+                                                               .withNumberOfThreads(numThreads));
+    }
+}
+
+EncryptionPool::SharedThreads::~SharedThreads()
+{
+    if (pool != nullptr) {
+        pool->removeAllJobs(true, 4000);
+    }
+}
+
+// One forEachChunk call. Helpers can start after the caller has finished
+// every chunk, when the shared threads were busy with other instances, so
+// they hold the batch and only touch the job if it's still open.
+struct EncryptionPool::Batch
+{
+    std::atomic<int> nextChunk { 0 };
+    CriticalSection lock;
+    int activeHelpers = 0;
+    bool closed = false;
+    WaitableEvent helpersDone;
+};
+
+EncryptionPool::EncryptionPool(int numThreads)
+{
+    if (numThreads <= 0) {
+        numThreads = SystemStats::getNumCpus();
+    }
+    numThreads = jlimit(1, maxThreads, numThreads);
+
+    for (int i = 0; i < numThreads; i++) {
+        lanes.add(new Lane());
+    }
+}
+
+void EncryptionPool::clearCodebooks() noexcept
+{
+    for (auto* lane : lanes) {
+        lane->codebook.clear();
+    }
+}
+
+void EncryptionPool::forEachChunk(int numChunks, const std::function<void(int chunk, Lane& lane)>& fn)
+{
+    auto batch = std::make_shared<Batch>();
+
+    auto runLane = [&fn, numChunks] (Batch& b, Lane& lane) {
+        for (int chunk = b.nextChunk++; chunk < numChunks; chunk = b.nextChunk++) {
+            fn(chunk, lane);
+        }
+    };
+
+    auto* pool = threads->pool.get();
+    const int numHelpers = pool != nullptr ? jmin(lanes.size(), pool->getNumThreads() + 1, numChunks) - 1 : 0;
+
+    for (int i = 1; i <= numHelpers; i++) {
+        pool->addJob([batch, runLane, &lane = *lanes[i]] {
+            {
+                const ScopedLock sl(batch->lock);
+                if (batch->closed) {
+                    return;
+                }
+                batch->activeHelpers++;
+            }
+
+            runLane(*batch, lane);
+
+            const ScopedLock sl(batch->lock);
+            if (--batch->activeHelpers == 0 && batch->closed) {
+                batch->helpersDone.signal();
+            }
+        });
+    }
+
+    runLane(*batch, *lanes[0]);
+
+    // Every chunk is claimed; wait only for helpers still working on one
+    bool waitForHelpers = false;
+    {
+        const ScopedLock sl(batch->lock);
+        batch->closed = true;
+        waitForHelpers = batch->activeHelpers > 0;
+    }
+    if (waitForHelpers) {
+        batch->helpersDone.wait();
+    }
+}
+
+EncryptionPool::Lane::ChunkResult EncryptionPool::Lane::encryptChunk(float* data, int numSamples, const String& key,
+                                                                     float normalizeScale, float quantizationStep,
+                                                                     int16_t* ciphertext)
+{
+    jassert(numSamples <= chunkSamples);
+    int16_t* samples = staging.getData();
+    auto* bytes = reinterpret_cast<uint8_t*>(samples);
+
+    // Normalize, clamp, quantize and convert to int16 with safety scaling
+    {
+        JUCECB_TRACE_SCOPE("encryption", "quantize");
+        EncryptionKernels::quantizeToInt16(data, numSamples, normalizeScale, quantizationStep, samples);
+    }
+
+    // Pad the last block to AES block size
+    int numBytes = numSamples * static_cast<int>(sizeof(int16_t));
+    const int padding = numBytes % EcbCipher::blockSize;
+    if (padding != 0) {
+        const int paddingSize = EcbCipher::blockSize - padding;
+        std::fill(bytes + numBytes, bytes + numBytes + paddingSize, static_cast<uint8_t>(paddingSize));
+        numBytes += paddingSize;
+    }
+
+    // Encrypt in place through the codebook, so each distinct block goes
+    // through AES once. The key schedule only reruns when the key changed.
+    ChunkResult result;
+    result.numBlocks = numBytes / EcbCipher::blockSize;
+    {
+        JUCECB_TRACE_SCOPE("encryption", "cipher");
+        result.numBlocksEncrypted = cipher.setKey(key) ? codebook.encryptInPlace(cipher, bytes, numBytes) : -1;
+    }
+    if (result.numBlocksEncrypted < 0) {
+        std::fill(samples, samples + numSamples, int16_t(0));
+        result.numBlocksEncrypted = result.numBlocks;
+    }
+
+    if (ciphertext != nullptr) {
+        std::copy(samples, samples + numSamples, ciphertext);
+    }
+
+    // Convert back to float with safety scaling
+    JUCECB_TRACE_SCOPE("encryption", "convertFromInt16");
+    result.encryptedSumOfSquares = EncryptionKernels::convertFromInt16(samples, numSamples, data);
+    return result;
+}
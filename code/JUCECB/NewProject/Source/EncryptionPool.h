@@ -0,0 +1,91 @@
+/*
+ ==============================================================================
+
+ Thread pool that spreads the encryption stages over fixed-size chunks.
+
+ ECB blocks are independent, so every stage of encryptAudioECB can work on
+ a chunk in isolation. Chunks are a fixed number of samples (a whole number
+ of cipher blocks) regardless of how many threads there are, so per-chunk
+ results merged in chunk order give the same output on any machine.
+
+ The worker threads are shared by every instance in the process, so a
+ session with many instances still runs one thread per core. Each pool
+ keeps its own lanes (cipher context, codebook and int16 staging tile),
+ one per thread that can work on its job, including the caller.
+
+ ==============================================================================
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "EcbCipher.h"
+#include "EcbCodebook.h"
+
+//==============================================================================
+class EncryptionPool
+{
+    public:
+    // One staging tile of int16 samples
+    static constexpr int chunkSamples = EcbCipher::tileBytes / static_cast<int>(sizeof(int16_t));
+    static_assert((chunkSamples * sizeof(int16_t)) % EcbCipher::blockSize == 0,
+                  "Chunks must hold whole cipher blocks");
+
+    static constexpr int maxThreads = 16;
+
+    struct Lane
+    {
+        Lane() { staging.allocate(static_cast<size_t>(chunkSamples), false); }
+
+        struct ChunkResult
+        {
+            juce::int64 encryptedSumOfSquares = 0; // In int16 units
+            int numBlocks = 0;
+            int numBlocksEncrypted = 0;            // Blocks the codebook didn't have
+        };
+
+        // Normalizes, clamps, quantizes, encrypts and converts back
+        // numSamples (at most chunkSamples) in place. The chunk must start on
+        // a cipher block; a partial last block is padded. A failed cipher
+        // leaves silence. If ciphertext isn't null, the int16 ciphertext is
+        // copied there as well.
+        ChunkResult encryptChunk(float* data, int numSamples, const String& key,
+                                 float normalizeScale, float quantizationStep,
+                                 int16_t* ciphertext = nullptr);
+
+        EcbCipher cipher;
+        EcbCodebook codebook;
+        HeapBlock<int16_t> staging;
+    };
+
+    // numThreads <= 0 uses one thread per CPU core
+    explicit EncryptionPool(int numThreads = 0);
+
+    int getNumThreads() const noexcept { return lanes.size(); }
+
+    // Starts every lane's codebook afresh, so one job's blocks don't crowd
+    // out the next's. Call between jobs, not during forEachChunk.
+    void clearCodebooks() noexcept;
+
+    // Calls fn(chunk, lane) once for every chunk in [0, numChunks), spread
+    // over the shared threads and the calling thread, and returns when all
+    // are done. Only one thread may call this at a time.
+    void forEachChunk(int numChunks, const std::function<void(int chunk, Lane& lane)>& fn);
+
+    private:
+    // One set of threads per process, shared by every pool
+    struct SharedThreads
+    {
+        SharedThreads();
+        ~SharedThreads();
+
+        std::unique_ptr<juce::ThreadPool> pool;
+    };
+
+    struct Batch;
+
+    juce::OwnedArray<Lane> lanes;
+    juce::SharedResourcePointer<SharedThreads> threads;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (EncryptionPool)
+};
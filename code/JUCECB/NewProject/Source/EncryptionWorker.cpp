@@ -0,0 +1,115 @@
+/*
+ ==============================================================================
+
+ Background thread that re-encrypts the sample whenever the key or the
+ quantize setting changes.
+
+ ==============================================================================
+ */
+
+#include "EncryptionWorker.h"
+#include "Tracing.h"
+
+//==============================================================================
+EncryptionWorker::EncryptionWorker(SampleSetExchange& exchangeToUse, Builder builderToUse)
+: Thread("JUCECB Encryption"),
+  exchange(exchangeToUse),
+  builder(std::move(builderToUse))
+{
+}
+
+EncryptionWorker::~EncryptionWorker()
+{
+    stop();
+}
+
+void EncryptionWorker::start()
+{
+    if (!isThreadRunning()) {
+        startThread(Priority::background);
+    }
+}
+
+void EncryptionWorker::stop()
+{
+    generation++; // Abort whatever is running
+    stopThread(4000);
+}
+
+void EncryptionWorker::request(SampleSource::Ptr source, const String& key, int quantize, SampleStorage storage,
+                               int delayMs)
+{
+    JUCECB_TRACE_SCOPE("encryption", "cacheLookup");
+    auto cached = cache.find(source, key, quantize, storage);
+
+    {
+        const ScopedLock sl(requestLock);
+        generation++; // Supersedes whatever is queued or running
+
+        if (cached != nullptr) {
+            nextRequest = {};
+            hasRequest = false;
+            exchange.publish(cached);
+            return;
+        }
+
+        nextRequest = { std::move(source), key, quantize };
+        hasRequest = true;
+        startTime = Time::getMillisecondCounter() + static_cast<uint32>(jmax(0, delayMs));
+        busy = true;
+    }
+    notify();
+}
+
+void EncryptionWorker::run()
+{
+    while (!threadShouldExit()) {
+        exchange.collectGarbage();
+
+        Request job;
+        uint32_t jobGeneration = 0;
+        int waitMs = collectIntervalMs;
+
+        {
+            const ScopedLock sl(requestLock);
+            if (hasRequest) {
+                const auto now = Time::getMillisecondCounter();
+                if (static_cast<int32>(startTime - now) > 0) {
+                    // Still debouncing
+                    waitMs = jmin(waitMs, static_cast<int>(startTime - now));
+                } else {
+                    job = std::move(nextRequest);
+                    nextRequest = {};
+                    hasRequest = false;
+                    jobGeneration = generation.load();
+                }
+            }
+        }
+
+        if (job.source == nullptr) {
+            wait(waitMs);
+            continue;
+        }
+
+        const AbortCheck shouldAbort = [this, jobGeneration] {
+            return threadShouldExit() || generation.load(std::memory_order_relaxed) != jobGeneration;
+        };
+
+        SampleSet::Ptr set;
+        {
+            JUCECB_TRACE_SCOPE_VALUE("encryption", "buildSampleSet", job.quantize);
+            set = builder(job.source, job.key, job.quantize, shouldAbort);
+        }
+
+        // Even a superseded set is worth keeping for when it's asked for again
+        cache.insert(set);
+
+        // Checked under the lock, so a newer request can't publish in between
+        const ScopedLock sl(requestLock);
+        if (set != nullptr && !shouldAbort()) {
+            exchange.publish(set);
+            DBG("Published sample set for key: " + job.key);
+        }
+        busy = hasRequest;
+    }
+}
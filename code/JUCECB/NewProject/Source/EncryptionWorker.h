@@ -0,0 +1,79 @@
+/*
+ ==============================================================================
+
+ Background thread that re-encrypts the sample whenever the key or the
+ quantize setting changes.
+
+ Requests are debounced, so typing a key only encrypts once the text stops
+ changing, and a newer request cancels one that is still running. Finished
+ sets are published through a SampleSetExchange, and the worker also frees
+ the sets the audio thread hands back.
+
+ Every finished set goes into an LRU cache. A request for a combination
+ that is still cached is published straight away, without the debounce.
+
+ ==============================================================================
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "SampleSet.h"
+#include "SampleSetCache.h"
+
+//==============================================================================
+class EncryptionWorker : private juce::Thread
+{
+    public:
+    // Returns true once the job has been superseded and should stop early
+    using AbortCheck = std::function<bool()>;
+
+    // Builds the encrypted set for a source, or returns nullptr if aborted
+    using Builder = std::function<SampleSet::Ptr (const SampleSource::Ptr& source, const String& key,
+                                                  int quantize, const AbortCheck& shouldAbort)>;
+
+    static constexpr int debounceMs = 150;
+    static constexpr int collectIntervalMs = 250;
+
+    EncryptionWorker(SampleSetExchange& exchangeToUse, Builder builderToUse);
+    ~EncryptionWorker() override;
+
+    void start();
+    void stop();
+
+    // Replaces any queued or running request. A set cached for the same
+    // storage setting is published immediately; otherwise the job starts
+    // once no newer request has arrived for delayMs.
+    void request(SampleSource::Ptr source, const String& key, int quantize, SampleStorage storage,
+                 int delayMs = debounceMs);
+
+    SampleSetCache& getCache() noexcept { return cache; }
+    const SampleSetCache& getCache() const noexcept { return cache; }
+
+    // True while a request is queued or being encrypted
+    bool isBusy() const noexcept { return busy.load(); }
+
+    private:
+    void run() override;
+
+    struct Request
+    {
+        SampleSource::Ptr source;
+        String key;
+        int quantize = 0;
+    };
+
+    SampleSetExchange& exchange;
+    Builder builder;
+    SampleSetCache cache;
+
+    juce::CriticalSection requestLock;
+    Request nextRequest;
+    bool hasRequest = false;
+    uint32 startTime = 0; // Millisecond counter when the queued request may start
+
+    std::atomic<uint32_t> generation { 0 };
+    std::atomic<bool> busy { false };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (EncryptionWorker)
+};
@@ -0,0 +1,157 @@
+/*
+ ==============================================================================
+
+ Realtime ECB insert effect for incoming audio.
+
+ ==============================================================================
+ */
+
+#include "LiveEcbEffect.h"
+#include "EncryptionKernels.h"
+
+//==============================================================================
+LiveEcbEffect::~LiveEcbEffect()
+{
+    delete activeCipher;
+    delete pendingCipher.exchange(nullptr);
+    delete retiredCipher.exchange(nullptr);
+}
+
+void LiveEcbEffect::prepare(double newSampleRate, int maximumBlockSize)
+{
+    sampleRate = newSampleRate > 0.0 ? newSampleRate : 44100.0;
+
+    // Whole frames only, plus room for the incomplete frame carried over
+    capacity = jmax(frameSamples, maximumBlockSize);
+    const auto queueSize = static_cast<size_t>(capacity + frameSamples);
+    inputFrames.allocate(queueSize, true);
+    encryptedQueue.allocate(queueSize, true);
+    dryQueue.allocate(queueSize, true);
+
+    reset();
+}
+
+void LiveEcbEffect::reset() noexcept
+{
+    // The output starts one frame behind, with silence in the queues
+    if (capacity > 0) {
+        std::fill(encryptedQueue.getData(), encryptedQueue.getData() + frameSamples, 0.0f);
+        std::fill(dryQueue.getData(), dryQueue.getData() + frameSamples, 0.0f);
+    }
+    pendingCount = 0;
+    inputMeanSquare = 0.0f;
+    encryptedMeanSquare = 0.0f;
+    currentGain = 0.0f;
+}
+
+void LiveEcbEffect::setKey(const String& key)
+{
+    collectRetiredCipher();
+
+    auto cipher = std::make_unique<EcbCipher>();
+    if (!cipher->setKey(key)) {
+        DBG("Live effect: could not set up the cipher");
+        return;
+    }
+
+    // Replaces a context the audio thread hasn't picked up yet
+    delete pendingCipher.exchange(cipher.release());
+}
+
+void LiveEcbEffect::collectRetiredCipher()
+{
+    delete retiredCipher.exchange(nullptr);
+}
+
+//==============================================================================
+void LiveEcbEffect::process(const float* input, float* output, int numSamples,
+                            int numLevels, float dryMix, float wetMix) noexcept
+{
+    jassert(capacity > 0);
+
+    // Take a new key only once the previous context has been handed back,
+    // so the audio thread never has to delete one
+    if (retiredCipher.load() == nullptr && pendingCipher.load() != nullptr) {
+        retiredCipher.store(activeCipher);
+        activeCipher = pendingCipher.exchange(nullptr);
+    }
+
+    for (int done = 0; done < numSamples;) {
+        const int length = jmin(capacity, numSamples - done);
+        processFrames(input + done, output + done, length, numLevels, dryMix, wetMix);
+        done += length;
+    }
+}
+
+void LiveEcbEffect::processFrames(const float* input, float* output, int numSamples,
+                                  int numLevels, float dryMix, float wetMix) noexcept
+{
+    int16_t* frames = inputFrames.getData();
+    float* encrypted = encryptedQueue.getData();
+    float* dry = dryQueue.getData();
+
+    // Encrypted samples already waiting: the rest of the latency is the
+    // incomplete input frame
+    const int queued = frameSamples - pendingCount;
+
+    // Keep the dry signal in step with the encrypted one. Copied before
+    // anything is written, since input and output may alias.
+    std::copy(input, input + numSamples, dry + frameSamples);
+
+    double inputSumOfSquares = 0.0;
+    float inputPeak = 0.0f;
+    EncryptionKernels::measure(input, numSamples, inputSumOfSquares, inputPeak);
+
+    // Quantize behind the incomplete frame, then encrypt every frame that is
+    // now complete in a single cipher call
+    const float quantizationStep = 1.9f / jmax(1, numLevels);
+    EncryptionKernels::quantizeToInt16(input, numSamples, 1.0f, quantizationStep, frames + pendingCount);
+
+    const int available = pendingCount + numSamples;
+    const int complete = available - available % frameSamples;
+    const int numBytes = complete * static_cast<int>(sizeof(int16_t));
+
+    if (activeCipher == nullptr
+        || !activeCipher->encryptInPlace(reinterpret_cast<uint8_t*>(frames), numBytes)) {
+        std::fill(frames, frames + complete, int16_t(0));
+    }
+
+    const juce::int64 encryptedSumOfSquares =
+        EncryptionKernels::convertFromInt16(frames, complete, encrypted + queued);
+
+    pendingCount = available - complete;
+    std::copy(frames + complete, frames + available, frames);
+
+    // Follow the loudness of both sides, and aim the encrypted signal at the
+    // input level with the same limits as encryptAudioECB
+    const float smoothing = static_cast<float>(std::exp(-numSamples / (levelSmoothingSeconds * sampleRate)));
+    inputMeanSquare = static_cast<float>(inputSumOfSquares / numSamples)
+                    + (inputMeanSquare - static_cast<float>(inputSumOfSquares / numSamples)) * smoothing;
+
+    if (complete > 0) {
+        const double int16Scale = EncryptionKernels::int16Scale;
+        const auto blockMeanSquare = static_cast<float>(static_cast<double>(encryptedSumOfSquares)
+                                                        / (int16Scale * int16Scale) / complete);
+        encryptedMeanSquare = blockMeanSquare + (encryptedMeanSquare - blockMeanSquare) * smoothing;
+    }
+
+    float targetGain = 0.0f;
+    if (encryptedMeanSquare > 0.0f) {
+        const float targetRMS = std::min(std::sqrt(inputMeanSquare), 0.25f);
+        targetGain = std::min(targetRMS / std::sqrt(encryptedMeanSquare), 2.0f);
+    }
+
+    // Ramp to the new gain across the block, clip and mix
+    const float gainStep = (targetGain - currentGain) / numSamples;
+    float gain = currentGain;
+    for (int i = 0; i < numSamples; i++) {
+        gain += gainStep;
+        const float wet = jlimit(-1.0f, 1.0f, encrypted[i] * gain);
+        output[i] = dry[i] * dryMix + wet * wetMix;
+    }
+    currentGain = targetGain;
+
+    // Carry the undelivered samples over to the next block
+    std::copy(encrypted + numSamples, encrypted + numSamples + frameSamples - pendingCount, encrypted);
+    std::copy(dry + numSamples, dry + numSamples + frameSamples, dry);
+}
@@ -0,0 +1,73 @@
+/*
+ ==============================================================================
+
+ Realtime ECB insert effect for incoming audio.
+
+ Input is quantized and converted to int16 exactly like a loaded sample,
+ then encrypted one AES block (8 samples) at a time as soon as a block is
+ complete. That makes the latency a fixed frameSamples, whatever the host
+ block size. Everything is preallocated in prepare(), and the cipher
+ context is keyed on the message thread and handed over through an atomic
+ pointer, so process() never allocates, locks or runs a key schedule. Its
+ cost is one EVP_EncryptUpdate plus a few vector passes per host block.
+
+ Since there is no whole file to normalize against, the encrypted signal is
+ matched to the input loudness with slowly smoothed RMS estimates.
+
+ ==============================================================================
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "EcbCipher.h"
+
+//==============================================================================
+class LiveEcbEffect
+{
+    public:
+    static constexpr int frameSamples = EcbCipher::blockSize / static_cast<int>(sizeof(int16_t));
+    static constexpr double levelSmoothingSeconds = 0.3;
+
+    LiveEcbEffect() = default;
+    ~LiveEcbEffect();
+
+    // Message thread, not while process() runs
+    void prepare(double sampleRate, int maximumBlockSize);
+
+    // Message thread. Keys a fresh cipher context and hands it to the audio
+    // thread, which picks it up at its next block.
+    void setKey(const String& key);
+
+    // Audio thread. Writes the effect for numSamples of input, delayed by
+    // getLatencySamples(). input and output may be the same buffer.
+    void process(const float* input, float* output, int numSamples,
+                 int numLevels, float dryMix, float wetMix) noexcept;
+
+    void reset() noexcept;
+
+    static constexpr int getLatencySamples() noexcept { return frameSamples; }
+
+    private:
+    void processFrames(const float* input, float* output, int numSamples,
+                       int numLevels, float dryMix, float wetMix) noexcept;
+    void collectRetiredCipher();
+
+    // Cipher handover: at most one context waits in each slot
+    std::atomic<EcbCipher*> pendingCipher { nullptr };
+    std::atomic<EcbCipher*> retiredCipher { nullptr };
+    EcbCipher* activeCipher = nullptr; // Audio thread
+
+    HeapBlock<int16_t> inputFrames;    // Quantized input; the first pendingCount are carried over
+    HeapBlock<float> encryptedQueue;   // Encrypted output not yet written, then this block's
+    HeapBlock<float> dryQueue;         // Input delayed to line up with the encrypted output
+    int pendingCount = 0;              // Input samples waiting for their frame to complete
+    int capacity = 0;
+
+    float inputMeanSquare = 0.0f;
+    float encryptedMeanSquare = 0.0f;
+    float currentGain = 0.0f;
+    double sampleRate = 44100.0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LiveEcbEffect)
+};
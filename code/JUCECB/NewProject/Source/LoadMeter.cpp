@@ -0,0 +1,104 @@
+/*
+ ==============================================================================
+
+ Realtime CPU load meter for the audio callback.
+
+ ==============================================================================
+ */
+
+#include "LoadMeter.h"
+
+//==============================================================================
+LoadMeter::LoadMeter()
+    : counterFrequency(getCounterFrequency())
+{
+}
+
+double LoadMeter::getCounterFrequency()
+{
+    static const double frequency = [] {
+       #if JUCE_INTEL
+        // The TSC runs at a constant rate on anything recent, but that rate
+        // isn't exposed, so measure it against the OS clock
+        const auto startTicks = Time::getHighResolutionTicks();
+        const auto startCount = readCounter();
+        Thread::sleep(20);
+        const auto elapsedCount = readCounter() - startCount;
+        const auto elapsedTicks = Time::getHighResolutionTicks() - startTicks;
+        return static_cast<double>(elapsedCount) * static_cast<double>(Time::getHighResolutionTicksPerSecond())
+               / static_cast<double>(jmax(juce::int64(1), elapsedTicks));
+       #elif JUCE_ARM && JUCE_64BIT && (JUCE_GCC || JUCE_CLANG)
+        juce::uint64 ticksPerSecond;
+        asm volatile ("mrs %0, cntfrq_el0" : "=r" (ticksPerSecond));
+        return static_cast<double>(ticksPerSecond);
+       #else
+        return static_cast<double>(Time::getHighResolutionTicksPerSecond());
+       #endif
+    }();
+    return frequency;
+}
+
+void LoadMeter::prepare(double newSampleRate)
+{
+    sampleRate = newSampleRate > 0.0 ? newSampleRate : 44100.0;
+    reset();
+}
+
+void LoadMeter::reset() noexcept
+{
+    resetRequested.store(false, std::memory_order_relaxed);
+    smoothedLoad = 0.0;
+    smoothedLoadPerVoice = 0.0;
+    averageLoad.store(0.0f, std::memory_order_relaxed);
+    peakLoad.store(0.0f, std::memory_order_relaxed);
+    loadPerVoice.store(0.0f, std::memory_order_relaxed);
+    overruns.store(0, std::memory_order_relaxed);
+    blocks.store(0, std::memory_order_relaxed);
+}
+
+float LoadMeter::end(juce::uint64 startCount, int numSamples, int numVoices, bool isRealtime) noexcept
+{
+    if (resetRequested.load(std::memory_order_relaxed)) {
+        reset();
+    }
+    if (numSamples <= 0) {
+        return 0.0f;
+    }
+
+    const double elapsedSeconds = static_cast<double>(readCounter() - startCount) / counterFrequency;
+    const double deadlineSeconds = numSamples / sampleRate;
+    const double load = elapsedSeconds / deadlineSeconds;
+
+    // One-pole smoothing with the same time constant whatever the block size
+    const double coefficient = 1.0 - std::exp(-deadlineSeconds / averagingSeconds);
+    smoothedLoad += (load - smoothedLoad) * coefficient;
+    averageLoad.store(static_cast<float>(smoothedLoad), std::memory_order_relaxed);
+
+    if (numVoices > 0) {
+        smoothedLoadPerVoice += (load / numVoices - smoothedLoadPerVoice) * coefficient;
+        loadPerVoice.store(static_cast<float>(smoothedLoadPerVoice), std::memory_order_relaxed);
+    }
+
+    // Only this thread raises the peak; a reader resetting it in between
+    // just loses this block's value
+    if (load > peakLoad.load(std::memory_order_relaxed)) {
+        peakLoad.store(static_cast<float>(load), std::memory_order_relaxed);
+    }
+
+    if (isRealtime && load > 1.0) {
+        overruns.fetch_add(1, std::memory_order_relaxed);
+    }
+    blocks.fetch_add(1, std::memory_order_relaxed);
+    return static_cast<float>(load);
+}
+
+LoadMeter::Statistics LoadMeter::getStatistics() const noexcept
+{
+    Statistics statistics;
+    statistics.averageLoad = averageLoad.load(std::memory_order_relaxed);
+    statistics.peakLoad = peakLoad.load(std::memory_order_relaxed);
+    statistics.loadPerVoice = loadPerVoice.load(std::memory_order_relaxed);
+    statistics.overruns = overruns.load(std::memory_order_relaxed);
+    statistics.blocks = blocks.load(std::memory_order_relaxed);
+    return statistics;
+}
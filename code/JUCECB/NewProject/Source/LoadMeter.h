@@ -0,0 +1,99 @@
+/*
+ ==============================================================================
+
+ Realtime CPU load meter for the audio callback.
+
+ Each block is timed with the CPU's cycle counter (RDTSC on x86, the
+ virtual counter on ARM64, JUCE's high resolution ticks elsewhere), which
+ costs a few nanoseconds, and compared with the block's deadline: its
+ length in samples divided by the sample rate. The audio thread only does
+ arithmetic and relaxed atomic stores, and any thread can read the results.
+
+ Load is the share of the deadline spent in processBlock, so 1.0 means the
+ block only just made it. Per-voice cost is the load divided by the
+ number of voices, and includes the fixed per-block work, so it errs
+ high; 1 / per-voice cost is a safe polyphony for the current buffer size.
+
+ ==============================================================================
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#if JUCE_INTEL
+ #if JUCE_MSVC
+  #include <intrin.h>
+ #else
+  #include <x86intrin.h>
+ #endif
+#endif
+
+//==============================================================================
+class LoadMeter
+{
+    public:
+    static constexpr double averagingSeconds = 0.5;
+
+    struct Statistics
+    {
+        float averageLoad = 0.0f;   // Smoothed over about averagingSeconds
+        float peakLoad = 0.0f;      // Since the last takePeakLoad()
+        float loadPerVoice = 0.0f;  // Smoothed, over blocks with voices playing
+        juce::int64 overruns = 0;   // Blocks that took longer than their deadline
+        juce::int64 blocks = 0;
+    };
+
+    LoadMeter();
+
+    // Message thread, not while blocks are being timed
+    void prepare(double sampleRate);
+    void reset() noexcept;
+
+    // Audio thread. Pass begin()'s result to end() with the block's length,
+    // the voices it rendered and whether the host runs in realtime; offline
+    // renders never count as overruns. Returns the block's load.
+    static juce::uint64 begin() noexcept { return readCounter(); }
+    float end(juce::uint64 startCount, int numSamples, int numVoices, bool isRealtime) noexcept;
+
+    // Any thread
+    Statistics getStatistics() const noexcept;
+    float takePeakLoad() noexcept { return peakLoad.exchange(0.0f, std::memory_order_relaxed); }
+
+    // Any thread. The audio thread clears everything at its next end(), so
+    // the smoothing state is only ever written there.
+    void requestReset() noexcept { resetRequested.store(true, std::memory_order_relaxed); }
+
+    private:
+    static juce::uint64 readCounter() noexcept
+    {
+       #if JUCE_INTEL
+        return __rdtsc();
+       #elif JUCE_ARM && JUCE_64BIT && (JUCE_GCC || JUCE_CLANG)
+        juce::uint64 count;
+        asm volatile ("mrs %0, cntvct_el0" : "=r" (count));
+        return count;
+       #else
+        return static_cast<juce::uint64>(Time::getHighResolutionTicks());
+       #endif
+    }
+
+    // Counter ticks per second, measured once per process
+    static double getCounterFrequency();
+
+    double counterFrequency = 0.0;
+    double sampleRate = 44100.0;
+
+    // Audio thread only
+    double smoothedLoad = 0.0;
+    double smoothedLoadPerVoice = 0.0;
+
+    std::atomic<float> averageLoad { 0.0f };
+    std::atomic<float> peakLoad { 0.0f };
+    std::atomic<float> loadPerVoice { 0.0f };
+    std::atomic<juce::int64> overruns { 0 };
+    std::atomic<juce::int64> blocks { 0 };
+    std::atomic<bool> resetRequested { false };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LoadMeter)
+};
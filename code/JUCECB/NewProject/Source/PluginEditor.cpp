@@ -9,6 +9,9 @@ JUCECBEditor::JUCECBEditor (JUCECB& p)
     loadButton.onClick = [this] { loadButtonClicked(); };
     addAndMakeVisible(loadButton);
     
+    // Only shown while a file is loading
+    addChildComponent(loadProgressBar);
+    
     // Set up wet/dry slider
     wetDrySlider.setSliderStyle(Slider::LinearHorizontal);
     wetDrySlider.setRange(0.0f, 1.0f, 0.01f);
@@ -60,11 +63,32 @@ JUCECBEditor::JUCECBEditor (JUCECB& p)
     
     loopAttachment.reset(new AudioProcessorValueTreeState::ButtonAttachment(audioProcessor.parameters, "loop", loopButton));
     
-    setSize(400, 280);
+    // Set up live input button
+    liveButton.setButtonText("Live Input");
+    liveButton.setColour(ToggleButton::textColourId, Colours::white);
+    addAndMakeVisible(liveButton);
+    
+    liveAttachment.reset(new AudioProcessorValueTreeState::ButtonAttachment(audioProcessor.parameters, "live", liveButton));
+    
+    // CPU load of the audio callback against its deadline
+    loadLabel.setColour(Label::textColourId, Colours::lightgrey);
+    loadLabel.setJustificationType(Justification::centred);
+    addAndMakeVisible(loadLabel);
+    
+   #if JUCECB_TRACING
+    // Dumps the recent stage timings of every thread for chrome://tracing
+    saveTraceButton.setButtonText("Save trace");
+    saveTraceButton.onClick = [this] { saveTrace(); };
+    addAndMakeVisible(saveTraceButton);
+   #endif
+    
+    setSize(400, 335);
+    startTimerHz(30);
 }
 
 JUCECBEditor::~JUCECBEditor()
 {
+    stopTimer();
 }
 
 void JUCECBEditor::paint(juce::Graphics& g)
@@ -92,7 +116,9 @@ void JUCECBEditor::resized()
     
     // Load button
     loadButton.setBounds(area.removeFromTop(buttonHeight).reduced(50, 0));
-    area.removeFromTop(10); // spacing
+    area.removeFromTop(5); // spacing
+    loadProgressBar.setBounds(area.removeFromTop(20).reduced(50, 0));
+    area.removeFromTop(5); // spacing
     
     // Wet/Dry slider
     auto sliderArea = area.removeFromTop(sliderHeight);
@@ -112,12 +138,60 @@ void JUCECBEditor::resized()
     keyInput.setBounds(keyArea);
     
     area.removeFromTop(10); // spacing
-    loopButton.setBounds(area.removeFromTop(buttonHeight));
+    auto toggleArea = area.removeFromTop(buttonHeight);
+    loopButton.setBounds(toggleArea.removeFromLeft(toggleArea.getWidth() / 2));
+    liveButton.setBounds(toggleArea);
+    
+    area.removeFromTop(5); // spacing
+    auto meterArea = area.removeFromTop(20);
+   #if JUCECB_TRACING
+    saveTraceButton.setBounds(meterArea.removeFromRight(80));
+   #endif
+    loadLabel.setBounds(meterArea);
 }
 
 void JUCECBEditor::loadButtonClicked()
 {
-    audioProcessor.loadFile();
+    if (audioProcessor.isLoading()) {
+        audioProcessor.cancelLoading();
+    } else {
+        audioProcessor.loadFile();
+    }
+}
+
+void JUCECBEditor::timerCallback()
+{
+    // The loader only publishes a progress value, so just poll it
+    const bool loading = audioProcessor.isLoading();
+    loadProgress = loading ? audioProcessor.getLoadProgress() : 0.0;
+    
+    if (loading != loadProgressBar.isVisible()) {
+        loadProgressBar.setVisible(loading);
+        loadButton.setButtonText(loading ? "Cancel loading" : "Load .wav file");
+    }
+    
+    updateLoadMeter();
+}
+
+void JUCECBEditor::updateLoadMeter()
+{
+    // The peak falls back over a second or so, and the text is only
+    // redrawn a few times a second so it can be read
+    heldPeakLoad = jmax(heldPeakLoad * 0.97f, audioProcessor.takePeakLoad());
+    if (++meterTicks < 8) {
+        return;
+    }
+    meterTicks = 0;
+    
+    const auto load = audioProcessor.getLoadStatistics();
+    String text;
+    text << "CPU " << roundToInt(load.averageLoad * 100.0f) << "%"
+         << "  peak " << roundToInt(heldPeakLoad * 100.0f) << "%"
+         << "  per voice " << String(load.loadPerVoice * 100.0f, 1) << "%"
+         << "  overruns " << String(load.overruns);
+    loadLabel.setText(text, dontSendNotification);
+    loadLabel.setColour(Label::textColourId, heldPeakLoad > 1.0f ? Colours::orangered
+                                             : heldPeakLoad > 0.7f ? Colours::orange : Colours::lightgrey);
 }
 
 void JUCECBEditor::keyInputChanged()
@@ -133,3 +207,18 @@ void JUCECBEditor::keyInputChanged()
         DBG("Key reset to default");
     }
 }
+
+void JUCECBEditor::saveTrace()
+{
+    // Next to the debug log, one file per dump
+    const auto file = File::getSpecialLocation(File::userHomeDirectory)
+                          .getChildFile("JUCECB_trace_" + Time::getCurrentTime().formatted("%Y%m%d_%H%M%S") + ".json");
+    
+    if (audioProcessor.writeTrace(file)) {
+        file.revealToUser();
+    } else {
+        AlertWindow::showMessageBoxAsync(AlertWindow::WarningIcon,
+                                       "Trace Not Saved",
+                                       "Could not write " + file.getFullPathName());
+    }
+}
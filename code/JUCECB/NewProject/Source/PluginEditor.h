@@ -14,7 +14,8 @@
 //==============================================================================
 /**
 */
-class JUCECBEditor : public juce::AudioProcessorEditor
+class JUCECBEditor : public juce::AudioProcessorEditor,
+                     private juce::Timer
 {
 public:
     JUCECBEditor (JUCECB&);
@@ -27,6 +28,8 @@ private:
     JUCECB& audioProcessor;
     
     TextButton loadButton;
+    double loadProgress = 0.0;
+    ProgressBar loadProgressBar { loadProgress };
     Slider wetDrySlider;
     Label wetDryLabel;
     TextEditor keyInput;
@@ -34,13 +37,24 @@ private:
     Slider gainSlider;
     Label gainLabel;
     ToggleButton loopButton;
+    ToggleButton liveButton;
+    Label loadLabel;
+   #if JUCECB_TRACING
+    TextButton saveTraceButton;
+   #endif
+    float heldPeakLoad = 0.0f;
+    int meterTicks = 0;
         
     std::unique_ptr<AudioProcessorValueTreeState::ButtonAttachment> loopAttachment;
+    std::unique_ptr<AudioProcessorValueTreeState::ButtonAttachment> liveAttachment;
     std::unique_ptr<AudioProcessorValueTreeState::SliderAttachment> gainAttachment;
     std::unique_ptr<AudioProcessorValueTreeState::SliderAttachment> wetDryAttachment;
 
     void loadButtonClicked();
     void keyInputChanged();
+    void timerCallback() override;
+    void updateLoadMeter();
+    void saveTrace();
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (JUCECBEditor)
 };
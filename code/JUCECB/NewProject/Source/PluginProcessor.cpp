@@ -15,6 +15,8 @@ JUCECB::JUCECB()
 #if ! JucePlugin_IsMidiEffect
 #if ! JucePlugin_IsSynth
                  .withInput("Input", juce::AudioChannelSet::mono(), true)
+#else
+                 .withInput("Live Input", juce::AudioChannelSet::mono(), false) // Only used in live mode
 #endif
                  .withOutput("Output", juce::AudioChannelSet::mono(), true)
 #endif
@@ -54,8 +56,24 @@ parameters(*this, nullptr, "Parameters",
     std::make_unique<juce::AudioParameterBool>(
                                                "loop",      // parameter ID
                                                "Loop",      // parameter name
-                                               true)        // default value (enabled)
-})
+                                               true),       // default value (enabled)
+    std::make_unique<juce::AudioParameterBool>(
+                                               "live",      // parameter ID
+                                               "Live Input", // parameter name
+                                               false)       // default value (play the sample)
+}),
+sampleLoader(formatManager, XFADE_LENGTH,
+             [this](SampleSource::Ptr source) {
+                 // Adopted on the message thread, see handleAsyncUpdate()
+                 const ScopedLock sl(sourceLock);
+                 pendingSource = std::move(source);
+                 triggerAsyncUpdate();
+             }),
+encryptionWorker(sampleSets,
+                 [this](const SampleSource::Ptr& source, const String& key, int numLevels,
+                        const EncryptionWorker::AbortCheck& shouldAbort) {
+                     return buildSampleSet(source, key, numLevels, shouldAbort);
+                 })
 {
     wetDryParameter = parameters.getRawParameterValue("wetdry");
     quantizationParameter = parameters.getRawParameterValue("quantize");
@@ -63,6 +81,9 @@ parameters(*this, nullptr, "Parameters",
     releaseTimeParameter = parameters.getRawParameterValue("release");
     gainParameter = parameters.getRawParameterValue("gain");
     loopEnabledParameter = parameters.getRawParameterValue("loop");
+    liveInputParameter = parameters.getRawParameterValue("live");
+    parameters.addParameterListener("live", this);
+    parameters.addParameterListener("quantize", this);
     
     // Create text parameter for encryption key separately
     encKeyParameter = new TextParameter("enckey", "Encryption Key", "DefaultKey123");
@@ -72,14 +93,33 @@ parameters(*this, nullptr, "Parameters",
     ERR_load_crypto_strings();
     
     formatManager.registerBasicFormats();
+    liveEffect.setKey(encryptionKey);
     
     File logFile = File::getSpecialLocation(File::userHomeDirectory).getChildFile("JUCECB_debug.log");
     fileLogger = std::make_unique<FileLogger>(logFile, "JUCECB Debug Log");
     Logger::setCurrentLogger(fileLogger.get());
+    JUCECB_TRACE_PREPARE();
+    
+    // Runtime log level override (0 = off, 1 = warning, 2 = info, 3 = debug)
+    auto envLevel = SystemStats::getEnvironmentVariable("JUCECB_LOG_LEVEL", {});
+    if (envLevel.isNotEmpty()) {
+        telemetry.setLevel(static_cast<TelemetryLevel>(jlimit(0, 3, envLevel.getIntValue())));
+    }
+    telemetry.start();
+    sampleStreamer.start();
+    sampleLoader.start();
+    encryptionWorker.start();
 }
 
 JUCECB::~JUCECB()
 {
+    parameters.removeParameterListener("live", this);
+    parameters.removeParameterListener("quantize", this);
+    sampleLoader.stop();
+    cancelPendingUpdate();
+    encryptionWorker.stop();
+    sampleStreamer.stop();
+    telemetry.stop();
     EVP_cleanup();
     ERR_free_strings();
     Logger::setCurrentLogger(nullptr);
@@ -150,6 +190,17 @@ void JUCECB::changeProgramName (int index, const String& newName)
 //==============================================================================
 void JUCECB::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
+    voices.prepare(sampleRate);
+    sampleSetFadeLength = jmax(1, roundToInt(KEY_XFADE_SECONDS * sampleRate));
+    sampleSetFadePosition = sampleSetFadeLength;
+    
+    // Voices are rendered in chunks of at most this many samples, so hosts
+    // that exceed the announced block size are simply sub-chunked.
+    renderChunkSize = jlimit(1, VoiceRenderer::chunkSize, samplesPerBlock);
+    
+    liveEffect.prepare(sampleRate, samplesPerBlock);
+    loadMeter.prepare(sampleRate);
+    updateLatency();
 }
 
 void JUCECB::releaseResources()
@@ -174,6 +225,11 @@ bool JUCECB::isBusesLayoutSupported (const BusesLayout& layouts) const
 #if ! JucePlugin_IsSynth
     if (layouts.getMainOutputChannelSet() != layouts.getMainInputChannelSet())
         return false;
+#else
+    // The live input is optional, but mono when enabled
+    if (!layouts.getMainInputChannelSet().isDisabled()
+        && layouts.getMainInputChannelSet() != AudioChannelSet::mono())
+        return false;
 #endif
     
     return true;
@@ -183,129 +239,251 @@ bool JUCECB::isBusesLayoutSupported (const BusesLayout& layouts) const
 
 void JUCECB::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
-    if (!hasLoadedFile) {
+    JUCECB_TRACE_THREAD_NAME("Audio");
+    JUCECB_TRACE_SCOPE_VALUE("audio", "processBlock", buffer.getNumSamples());
+    const auto meterStart = LoadMeter::begin();
+    const auto blockStart = processedSamples;
+    processedSamples += buffer.getNumSamples();
+    
+    renderBlock(buffer, midiMessages, blockStart);
+    
+    // Offline renders may take as long as they like
+    const bool isRealtime = !isNonRealtime();
+    const float load = loadMeter.end(meterStart, buffer.getNumSamples(), voices.size(), isRealtime);
+    if (isRealtime && load > 1.0f) {
+        telemetry.post(TelemetryLevel::warning, TelemetryEvent::Type::overrun, blockStart,
+                       -1, buffer.getNumSamples(), load);
+    }
+}
+
+void JUCECB::renderBlock(AudioBuffer<float>& buffer, MidiBuffer& midiMessages, juce::int64 blockStart)
+{
+    // Pick up a newly encrypted or loaded sample
+    if (sampleSets.update()) {
+        JUCECB_TRACE_SCOPE("audio", "sampleSetSwap");
+        beginSampleSetTransition();
+    }
+    
+    // A new live session starts from silence rather than replaying the
+    // last session's delayed frame and gain
+    const bool liveInputEnabled = isLiveInputEnabled();
+    if (liveInputEnabled && !liveInputWasEnabled) {
+        liveEffect.reset();
+    }
+    liveInputWasEnabled = liveInputEnabled;
+    
+    if (liveInputEnabled) {
+        JUCECB_TRACE_SCOPE("audio", "liveInput");
+        processLiveInput(buffer);
+        return;
+    }
+    
+    if (sampleSets.current() == nullptr) {
         buffer.clear();
         return;
     }
 
-    float maxLevel = 0.0f;
-    for (int channel = 0; channel < buffer.getNumChannels(); channel++) {
-        const float* data = buffer.getReadPointer(channel);
-        for (int i = 0; i < buffer.getNumSamples(); i++) {
-            maxLevel = std::max(maxLevel, std::abs(data[i]));
+    ScopedNoDenormals noDenormals;
+    
+    // Clear inactive voices first
+    int removed = 0;
+    {
+        JUCECB_TRACE_SCOPE("audio", "voiceCleanup");
+        removed = voices.removeInactive();
+    }
+    if (removed > 0) {
+        telemetry.post(TelemetryLevel::debug, TelemetryEvent::Type::voiceCleanup, blockStart,
+                       -1, removed);
+    }
+    
+    buffer.clear();
+    float* output = buffer.getWritePointer(0);
+    const int numSamples = buffer.getNumSamples();
+    int renderedUpTo = 0;
+    
+    for (const auto metadata : midiMessages) {
+        // Render up to the event first so it takes effect on its exact sample
+        const int eventPosition = jlimit(0, numSamples, metadata.samplePosition);
+        if (eventPosition > renderedUpTo) {
+            renderVoices(output + renderedUpTo, eventPosition - renderedUpTo);
+            renderedUpTo = eventPosition;
         }
+        
+        handleMidiEvent(metadata.getMessage(), blockStart + eventPosition);
+    }
+    
+    if (renderedUpTo < numSamples) {
+        renderVoices(output + renderedUpTo, numSamples - renderedUpTo);
     }
     
-    if (maxLevel > 0.95f) {
-        Logger::writeToLog("Warning: High output level detected: " + String(maxLevel));
+    const float peakLevel = buffer.getMagnitude(0, 0, buffer.getNumSamples());
+    if (peakLevel > 0.95f) {
+        telemetry.post(TelemetryLevel::warning, TelemetryEvent::Type::peakLevel, blockStart,
+                       -1, 0, peakLevel);
     }
+    telemetry.post(TelemetryLevel::debug, TelemetryEvent::Type::blockState, blockStart,
+                   -1, voices.size(), peakLevel);
+    
+    if (sampleSetFadePosition >= sampleSetFadeLength) {
+        sampleSets.endTransition();
+    }
+}
 
+void JUCECB::processLiveInput(AudioBuffer<float>& buffer)
+{
     ScopedNoDenormals noDenormals;
-    static const int MAX_VOICES = 4;
     
-    // Log current state before processing
-    Logger::writeToLog(String("Block start - Active voices: ") + String(voices.size()));
+    // Held notes would otherwise resume wherever they were when live mode ends
+    voices.reset();
     
-    // Clear inactive voices first
-    auto oldSize = voices.size();
-    voices.erase(
-        std::remove_if(voices.begin(), voices.end(),
-            [](const Voice& voice) {
-                bool shouldRemove = !voice.isActive;
-                if (shouldRemove) {
-                    Logger::writeToLog("Removing inactive voice");
-                }
-                return shouldRemove;
-            }),
-        voices.end()
-    );
-    if (oldSize != voices.size()) {
-        Logger::writeToLog(String("Cleaned up ") + String(oldSize - voices.size()) + " voices");
+    const int numSamples = buffer.getNumSamples();
+    if (getTotalNumInputChannels() == 0) {
+        // The host isn't feeding the input bus; still run silence through so
+        // the delay line stays in step
+        buffer.clear();
     }
     
-    for (const auto metadata : midiMessages) {
-        const auto msg = metadata.getMessage();
-        
-        if (msg.isNoteOn()) {
-            Logger::writeToLog(String("Note On - Note: ") + String(msg.getNoteNumber()) +
-                              String(" Active voices: ") + String(voices.size()));
-            
-            // Stop any existing voices for this note
-            for (auto& voice : voices) {
-                if (voice.midiNote == msg.getNoteNumber()) {
-                    Logger::writeToLog(String("Stopping existing voice for note: ") +
-                                     String(msg.getNoteNumber()));
-                    voice.isActive = false;
-                }
-            }
-            
-            double playbackRate = std::pow(2.0, (msg.getNoteNumber() - midiRootNote) / 12.0);
-            float velocity = msg.getVelocity() / 127.0f;
-            
-            if (voices.size() >= MAX_VOICES) {
-                // Find the oldest voice
-                auto oldestVoice = std::min_element(voices.begin(), voices.end(),
-                    [](const Voice& a, const Voice& b) {
-                        return a.attackStart < b.attackStart;
-                    });
-                    
-                Logger::writeToLog(String("Stealing oldest voice with note: ") +
-                                  String(oldestVoice->midiNote));
-                                  
-                // Apply quick fade out to previous voice
-                oldestVoice->previousSample = 0.0f;  // Reset the smoothing
-                
-                oldestVoice->midiNote = msg.getNoteNumber();
-                oldestVoice->playbackRate = playbackRate;
-                oldestVoice->basePlaybackRate = playbackRate;
-                oldestVoice->velocity = velocity;
-                oldestVoice->samplePosition = 0;
-                oldestVoice->isReleasing = false;
-                oldestVoice->isActive = true;
-                oldestVoice->attackStart = oldestVoice->samplePosition;
-            } else {
-                voices.emplace_back(msg.getNoteNumber(), playbackRate, velocity, getSampleRate(),
-                                  originalBuffer.getNumSamples());
-                Logger::writeToLog(String("Added new voice for note: ") +
-                                  String(msg.getNoteNumber()));
-            }
+    float* channel = buffer.getWritePointer(0);
+    const float wetMix = wetDryParameter->load();
+    liveEffect.process(channel, channel, numSamples, static_cast<int>(quantizationParameter->load()),
+                       1.0f - wetMix, wetMix);
+    
+    buffer.applyGain(0, 0, numSamples, std::pow(10.0f, gainParameter->load() / 20.0f));
+    for (int channelIndex = 1; channelIndex < buffer.getNumChannels(); channelIndex++) {
+        buffer.clear(channelIndex, 0, numSamples);
+    }
+}
+
+void JUCECB::updateLatency()
+{
+    setLatencySamples(isLiveInputEnabled() ? LiveEcbEffect::getLatencySamples() : 0);
+}
+
+void JUCECB::parameterChanged(const String& parameterID, float newValue)
+{
+    // May arrive on the audio thread from automation
+    if (parameterID == "live" || parameterID == "quantize") {
+        triggerAsyncUpdate();
+    }
+}
+
+void JUCECB::handleAsyncUpdate()
+{
+    updateLatency();
+    applyRestoredState();
+    adoptLoadedSource();
+    
+    // Sets for settings visited during a sweep are usually still cached, so
+    // going back to one is instant; anything else waits for the debounce
+    if (hasLoadedFile && static_cast<int>(quantizationParameter->load()) != requestedQuantize) {
+        requestEncryption();
+        DBG("Re-encrypting with " + String(requestedQuantize) + " quantize levels");
+    }
+}
+
+void JUCECB::adoptLoadedSource()
+{
+    SampleSource::Ptr source;
+    {
+        const ScopedLock sl(sourceLock);
+        source = std::move(pendingSource);
+        if (source == nullptr) {
+            return;
         }
-        else if (msg.isNoteOff()) {
-            Logger::writeToLog(String("Note Off - Note: ") + String(msg.getNoteNumber()));
-            bool foundVoice = false;
-            
-            for (auto& voice : voices) {
-                if (voice.midiNote == msg.getNoteNumber() && !voice.isReleasing) {
-                    voice.triggerRelease();
-                    foundVoice = true;
-                    Logger::writeToLog(String("Released voice for note: ") +
-                                     String(msg.getNoteNumber()));
-                    break;
-                }
-            }
-            
-            if (!foundVoice) {
-                Logger::writeToLog(String("No active voice found for note off: ") +
-                                 String(msg.getNoteNumber()));
-            }
+        
+        const auto hash = SampleLoader::hashToString(source->contentHash);
+        if (source->file == sessionFile && sessionHash.isNotEmpty() && sessionHash != hash) {
+            DBG(source->file.getFullPathName() + " has changed since the session was saved");
         }
-        else if (msg.isPitchWheel()) {
-            const double pitchWheelValue = (msg.getPitchWheelValue() - 8192) / 8192.0;
-            const double pitchBendRange = pitchBendRangeParameter->load();
-            const double pitchBendFactor = std::pow(2.0, pitchWheelValue * pitchBendRange / 12.0);
-            
-            for (auto& voice : voices) {
-                voice.playbackRate = voice.basePlaybackRate * pitchBendFactor;
-            }
+        sessionFile = source->file;
+        sessionHash = hash;
+        
+        // Encryptions of the previous file won't be asked for again
+        if (loadedSource != nullptr) {
+            encryptionWorker.getCache().removeSource(loadedSource);
         }
+        loadedSource = source;
     }
     
-    buffer.clear();
+    // Encrypt the buffer with quantization; the audio thread switches to
+    // the new sample once it is ready
+    requestEncryption(0);
+    
+    hasLoadedFile = true;
+    currentSamplePosition = 0;
+    DBG("File loaded successfully in mono");
+}
+
+void JUCECB::beginSampleSetTransition()
+{
+    const auto* previous = sampleSets.previous();
+    
+    if (previous != nullptr && previous->source == sampleSets.current()->source) {
+        // Same sample with a new key: playing voices crossfade to it
+        sampleSetFadePosition = 0;
+    } else {
+        // A different sample: the old voice positions mean nothing in it
+        voices.reset();
+        sampleSetFadePosition = sampleSetFadeLength;
+        sampleSets.endTransition();
+    }
+}
+
+void JUCECB::handleMidiEvent(const MidiMessage& msg, juce::int64 eventTime)
+{
+    if (msg.isNoteOn()) {
+        telemetry.post(TelemetryLevel::info, TelemetryEvent::Type::noteOn, eventTime,
+                       msg.getNoteNumber(), voices.size(), msg.getFloatVelocity());
+        
+        // Stop any existing voices for this note
+        voices.removeNote(msg.getNoteNumber());
+        
+        double playbackRate = std::pow(2.0, (msg.getNoteNumber() - midiRootNote) / 12.0);
+        float velocity = msg.getVelocity() / 127.0f;
+        
+        if (voices.isFull()) {
+            // Restart the oldest voice with the new note; this also resets its smoothing
+            int stolenNote = -1;
+            voices.stealOldest(msg.getNoteNumber(), playbackRate, velocity, stolenNote);
+            telemetry.post(TelemetryLevel::info, TelemetryEvent::Type::voiceSteal, eventTime,
+                           stolenNote);
+        } else {
+            voices.startVoice(msg.getNoteNumber(), playbackRate, velocity);
+        }
+    }
+    else if (msg.isNoteOff()) {
+        const int slot = voices.findHeldVoice(msg.getNoteNumber());
+        const bool foundVoice = slot >= 0;
+        
+        if (foundVoice) {
+            voices.triggerRelease(slot, releaseTimeParameter->load());
+        }
+        
+        telemetry.post(TelemetryLevel::info,
+                       foundVoice ? TelemetryEvent::Type::noteOff
+                                  : TelemetryEvent::Type::noteOffUnmatched,
+                       eventTime, msg.getNoteNumber());
+    }
+    else if (msg.isPitchWheel()) {
+        const double pitchWheelValue = (msg.getPitchWheelValue() - 8192) / 8192.0;
+        const double pitchBendRange = pitchBendRangeParameter->load();
+        const double pitchBendFactor = std::pow(2.0, pitchWheelValue * pitchBendRange / 12.0);
+        
+        voices.setPitchBend(pitchBendFactor);
+    }
+}
+
+void JUCECB::renderVoices(float* output, int numSamples)
+{
+    // Crossfade position of this sub-block, if a key change is fading in
+    const int fadeStart = sampleSetFadePosition;
+    sampleSetFadePosition = jmin(sampleSetFadeLength, sampleSetFadePosition + numSamples);
     
-    if (voices.empty()) {
-        return;  // Exit early if no voices to process
+    if (voices.isEmpty()) {
+        return;
     }
     
+    JUCECB_TRACE_SCOPE_VALUE("audio", "renderVoices", numSamples);
     float wetMix = wetDryParameter->load();
     float dryMix = 1.0f - wetMix;
     float gainInDB = gainParameter->load();
@@ -313,105 +491,197 @@ void JUCECB::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& mi
     
     float polyScale = 0.5f / std::sqrt(static_cast<float>(voices.size()));
     
-    AudioBuffer<float> tempBuffer(1, buffer.getNumSamples());
     bool loopEnabled = loopEnabledParameter->load() > 0.5f;
     
-    for (auto& voice : voices) {
-        if (!voice.isActive) continue;
+    const SampleSet& set = *sampleSets.current();
+    if (set.source->getLoopLength() <= 0) {
+        return; // The loader never publishes these, but wrapping would never end
+    }
+    const SampleSet* fadingSet = fadeStart < sampleSetFadeLength ? sampleSets.previous() : nullptr;
+    JUCECB_TRACE_SCOPE_IF(fadingSet != nullptr, "audio", "keyCrossfade");
+    const double numSourceSamples = static_cast<double>(set.source->length);
+    const double loopLength = static_cast<double>(set.source->getLoopLength());
+    float* mixed = renderScratch.data();
+    float* envelope = envelopeScratch.data();
+    float* fading = fadeScratch.data();
+    
+    for (int v = 0; v < voices.size(); v++) {
+        if (!voices.active[static_cast<size_t>(v)]) continue;
         
-        tempBuffer.clear();
-        float* channelData = tempBuffer.getWritePointer(0);
-        const float* originalData = originalBuffer.getReadPointer(0);
-        const float* encryptedData = encryptedBuffer.getReadPointer(0);
+        double& samplePosition = voices.samplePosition[static_cast<size_t>(v)];
+        const double voicePlaybackRate = voices.playbackRate[static_cast<size_t>(v)];
+        float& previousSample = voices.previousSample[static_cast<size_t>(v)];
+        const float velocity = voices.velocity[static_cast<size_t>(v)];
         
-        for (int sample = 0; sample < buffer.getNumSamples(); sample++) {
-            double readPosition = voice.samplePosition + (sample * voice.playbackRate);
-            double nextLoopPosition = readPosition;
-            
-            while (nextLoopPosition >= originalBuffer.getNumSamples()) {
-                nextLoopPosition -= originalBuffer.getNumSamples();
-            }
-            
-            // Current position interpolation
-            int pos1 = static_cast<int>(readPosition);
-            int pos2 = pos1 + 1;
-            float fraction = static_cast<float>(readPosition - pos1);
+        bool voiceFinished = false;
+        double runOrigin = samplePosition; // Only ever moved back by whole loops
+        
+        for (int chunkStart = 0; chunkStart < numSamples && !voiceFinished; chunkStart += renderChunkSize) {
+            // A shorter envelope means the release ends inside this chunk
+            const int fullChunkLength = jmin(renderChunkSize, numSamples - chunkStart);
+            const int chunkLength = voices.renderEnvelope(v, envelope, fullChunkLength);
+            voiceFinished = chunkLength < fullChunkLength;
             
-            // Handle wrapping for main sample
-            if (pos1 >= originalBuffer.getNumSamples()) {
-                pos1 %= originalBuffer.getNumSamples();
-                pos2 = (pos1 + 1) % originalBuffer.getNumSamples();
-            } else if (pos2 >= originalBuffer.getNumSamples()) {
-                pos2 = 0;
+            if (fadingSet != nullptr && fadeStart + chunkStart < sampleSetFadeLength) {
+                // Both sets share the source, so the run origin moves identically
+                double fadingOrigin = runOrigin;
+                renderVoiceChunk(*fadingSet, v, fadingOrigin, chunkStart, chunkLength,
+                                 loopEnabled, dryMix, wetMix, fading);
+                renderVoiceChunk(set, v, runOrigin, chunkStart, chunkLength,
+                                 loopEnabled, dryMix, wetMix, mixed);
+                
+                const float fadeStep = 1.0f / static_cast<float>(sampleSetFadeLength);
+                for (int i = 0; i < chunkLength; i++) {
+                    const float fade = jmin(1.0f, static_cast<float>(fadeStart + chunkStart + i) * fadeStep);
+                    mixed[i] = fading[i] + (mixed[i] - fading[i]) * fade;
+                }
+            } else {
+                renderVoiceChunk(set, v, runOrigin, chunkStart, chunkLength,
+                                 loopEnabled, dryMix, wetMix, mixed);
             }
             
-            // Get main samples
-            float drySample = originalData[pos1] + (originalData[pos2] - originalData[pos1]) * fraction;
-            float wetSample = encryptedData[pos1] + (encryptedData[pos2] - encryptedData[pos1]) * fraction;
-            
-            // Calculate next loop's samples for crossfade
-            int nextPos1 = static_cast<int>(nextLoopPosition);
-            int nextPos2 = (nextPos1 + 1) % originalBuffer.getNumSamples();
-            float nextFraction = static_cast<float>(nextLoopPosition - nextPos1);
-            
-            float dryNextSample = originalData[nextPos1] + (originalData[nextPos2] - originalData[nextPos1]) * nextFraction;
-            float wetNextSample = encryptedData[nextPos1] + (encryptedData[nextPos2] - encryptedData[nextPos1]) * nextFraction;
-            
-            // Handle non-looping sample end with envelope
-            if (!loopEnabled && readPosition >= originalBuffer.getNumSamples() - Voice::XFADE_LENGTH) {
-                float fadeOutGain = 1.0f - ((readPosition - (originalBuffer.getNumSamples() - Voice::XFADE_LENGTH)) / Voice::XFADE_LENGTH);
-                fadeOutGain = std::max(0.0f, std::min(1.0f, fadeOutGain));
+            for (int i = 0; i < chunkLength; i++) {
+                const int sample = chunkStart + i;
+                const double readPosition = samplePosition + (sample * voicePlaybackRate);
+                float mixedSample = mixed[i];
                 
-                if (readPosition >= originalBuffer.getNumSamples()) {
-                    voice.isActive = false;
-                    break;
+                // Handle non-looping sample end with envelope
+                if (!loopEnabled && readPosition >= numSourceSamples - XFADE_LENGTH) {
+                    if (readPosition >= numSourceSamples) {
+                        voices.active[static_cast<size_t>(v)] = 0;
+                        voiceFinished = true;
+                        break;
+                    }
+                    
+                    float fadeOutGain = 1.0f - ((readPosition - (numSourceSamples - XFADE_LENGTH)) / XFADE_LENGTH);
+                    fadeOutGain = std::max(0.0f, std::min(1.0f, fadeOutGain));
+                    mixedSample *= fadeOutGain;
                 }
                 
-                // Apply fade out envelope to both dry and wet samples
-                drySample *= fadeOutGain;
-                wetSample *= fadeOutGain;
+                // Apply smoothing to the mixed signal
+                const float smoothingFactor = 0.99f;
+                float finalSample = previousSample * smoothingFactor + mixedSample * (1.0f - smoothingFactor);
+                previousSample = finalSample;
+                
+                // Apply final scaling and accumulate straight into the output
+                output[sample] += finalSample * envelope[i] * velocity * polyScale * gainFactor;
             }
-            
-            // Crossfade near loop points (only if looping is enabled)
-            if (loopEnabled) {
-                float distanceToEnd = originalBuffer.getNumSamples() - readPosition;
-                if (distanceToEnd < Voice::XFADE_LENGTH) {
-                    float crossfadeGain = 0.5f * (1.0f + std::cos((distanceToEnd / Voice::XFADE_LENGTH) * M_PI));
-                    drySample = drySample * (1.0f - crossfadeGain) + dryNextSample * crossfadeGain;
-                    wetSample = wetSample * (1.0f - crossfadeGain) + wetNextSample * crossfadeGain;
-                }
+        }
+        
+        if (loopEnabled) {
+            samplePosition += numSamples * voicePlaybackRate;
+            while (samplePosition >= numSourceSamples) {
+                samplePosition -= loopLength;
             }
-            
-            // Apply envelope
-            float envelopeGain = voice.getEnvelopeGain(voice.samplePosition + sample * voice.playbackRate);
-            
-            // Mix wet/dry
-            float finalSample = (drySample * dryMix + wetSample * wetMix);
-            
-            // Apply smoothing to the mixed signal
-            const float smoothingFactor = 0.99f;
-            finalSample = voice.previousSample * smoothingFactor + finalSample * (1.0f - smoothingFactor);
-            voice.previousSample = finalSample;
-            
-            // Apply final scaling
-            channelData[sample] = finalSample * envelopeGain * voice.velocity * polyScale * gainFactor;
+        } else {
+            samplePosition += numSamples * voicePlaybackRate;
+        }
+        
+        requestReadAhead(set, samplePosition, voicePlaybackRate);
+        if (fadingSet != nullptr) {
+            requestReadAhead(*fadingSet, samplePosition, voicePlaybackRate);
         }
+    }
+}
+
+void JUCECB::renderVoiceChunk(const SampleSet& set, int voice, double& runOrigin, int chunkStart, int chunkLength,
+                              bool loopEnabled, float dryMix, float wetMix, float* dest)
+{
+    const double voicePlaybackRate = voices.playbackRate[static_cast<size_t>(voice)];
+    const SampleSource& source = *set.source;
+    const auto originalData = source.getSamples();
+    const auto encryptedData = set.getEncryptedSamples();
+    const float* originalTail = source.loopTail.getReadPointer(0);
+    const float* encryptedTail = set.encryptedTail.getReadPointer(0);
+    const double numSourceSamples = static_cast<double>(source.length);
+    const double loopLength = static_cast<double>(source.getLoopLength());
+    const int loopCrossfadeLength = source.crossfadeLength;
+    const double tailStart = numSourceSamples - loopCrossfadeLength;
+    
+    // Interpolate and mix the whole chunk in runs that each read one
+    // contiguous source: the sample body, or the baked loop tail while
+    // looping. Guard samples after both mean no run needs a modulo.
+    for (int done = 0; done < chunkLength;) {
+        const int first = chunkStart + done;
+        double basePosition = runOrigin;
+        double readPosition = basePosition + (first * voicePlaybackRate);
         
-        buffer.addFrom(0, 0, tempBuffer, 0, 0, buffer.getNumSamples());
+        VoiceRenderer::Samples dry = originalData;
+        VoiceRenderer::Samples wet = encryptedData;
+        bool inTail = false;
+        double limit = numSourceSamples;
         
-        if (loopEnabled) {
-            voice.samplePosition += buffer.getNumSamples() * voice.playbackRate;
-            while (voice.samplePosition >= originalBuffer.getNumSamples()) {
-                voice.samplePosition -= originalBuffer.getNumSamples();
+        if (!loopEnabled) {
+            if (readPosition >= numSourceSamples) {
+                break; // The voice ends here, see renderVoices()
             }
         } else {
-            voice.samplePosition += buffer.getNumSamples() * voice.playbackRate;
+            if (readPosition >= numSourceSamples) {
+                // Bring the run start back into [loopStart, sampleLength)
+                basePosition -= (std::floor((readPosition - numSourceSamples) / loopLength) + 1.0) * loopLength;
+                readPosition = basePosition + (first * voicePlaybackRate);
+            }
+            
+            const double tailBase = basePosition - tailStart;
+            if (readPosition < tailStart) {
+                limit = tailStart;
+            } else if (tailBase + (first * voicePlaybackRate) < loopCrossfadeLength) {
+                dry = originalTail;
+                wet = encryptedTail;
+                inTail = true;
+                basePosition = tailBase;
+                limit = loopCrossfadeLength;
+            } else {
+                // Rounding put the run start on the wrap point itself
+                runOrigin -= loopLength;
+                continue;
+            }
         }
+        
+        if (!inTail && readPosition >= source.headLength) {
+            // Past the head of a streamed sample: read from the page instead
+            const int page = static_cast<int>(readPosition / SamplePager::pageSamples);
+            const double pageStart = static_cast<double>(page) * SamplePager::pageSamples;
+            const int run = VoiceRenderer::countSamplesBelow(basePosition, voicePlaybackRate, first, chunkLength - done,
+                                                             jmin(limit, pageStart + SamplePager::pageSamples));
+            
+            if (const auto* slot = set.pager->acquire(page)) {
+                VoiceRenderer::renderInterpolated(slot->dry.getData(), slot->wet.getData(), basePosition - pageStart,
+                                                  voicePlaybackRate, first, run, dryMix, wetMix, dest + done);
+                set.pager->release(slot);
+            } else {
+                // Not read in time; the pager counts the dropout
+                std::fill(dest + done, dest + done + run, 0.0f);
+            }
+            done += run;
+            continue;
+        }
+        
+        if (!inTail) {
+            limit = jmin(limit, static_cast<double>(source.headLength));
+        }
+        
+        const int run = VoiceRenderer::countSamplesBelow(basePosition, voicePlaybackRate, first,
+                                                         chunkLength - done, limit);
+        VoiceRenderer::renderInterpolated(dry, wet, basePosition, voicePlaybackRate, first, run,
+                                          dryMix, wetMix, dest + done);
+        done += run;
+    }
+}
+
+void JUCECB::requestReadAhead(const SampleSet& set, double position, double rate)
+{
+    if (set.pager == nullptr) {
+        return;
     }
     
-    // Log final state
-    Logger::writeToLog(String("Block end - Active voices: ") + String(voices.size()));
+    // Everything this voice reaches within the read-ahead time, capped so
+    // a very high note can't ask for more pages than fit
+    const double window = jmin(STREAM_READ_AHEAD_SECONDS * getSampleRate() * rate,
+                               static_cast<double>(STREAM_READ_AHEAD_PAGES) * SamplePager::pageSamples);
+    set.pager->requestRange(jmax(position, static_cast<double>(set.source->headLength)), position + window);
 }
+
 //==============================================================================
 bool JUCECB::hasEditor() const
 {
@@ -427,6 +697,24 @@ AudioProcessorEditor* JUCECB::createEditor()
 void JUCECB::getStateInformation (MemoryBlock& destData)
 {
     auto state = parameters.copyState();
+    
+    // The key and the sample aren't parameter values, so they are stored as
+    // properties next to them. Quantize is a parameter and already saved.
+    // A restored state that hasn't been applied yet is saved as restored.
+    {
+        const ScopedLock sl(sourceLock);
+        state.setProperty("encryptionKey", restoredKey.isNotEmpty() ? restoredKey : encryptionKey, nullptr);
+        
+        const auto& file = hasRestoredSample ? restoredFile : sessionFile;
+        if (file != File()) {
+            state.setProperty("samplePath", file.getFullPathName(), nullptr);
+            state.setProperty("sampleHash", hasRestoredSample ? restoredHash : sessionHash, nullptr);
+        } else {
+            state.removeProperty("samplePath", nullptr);
+            state.removeProperty("sampleHash", nullptr);
+        }
+    }
+    
     std::unique_ptr<XmlElement> xml(state.createXml());
     copyXmlToBinary(*xml, destData);
 }
@@ -434,173 +722,165 @@ void JUCECB::getStateInformation (MemoryBlock& destData)
 void JUCECB::setStateInformation (const void* data, int sizeInBytes)
 {
     std::unique_ptr<XmlElement> xmlState(getXmlFromBinary(data, sizeInBytes));
-    if (xmlState.get() != nullptr)
-        parameters.replaceState(ValueTree::fromXml(*xmlState));
+    if (xmlState.get() == nullptr) {
+        return;
+    }
+    
+    const auto state = ValueTree::fromXml(*xmlState);
+    parameters.replaceState(state);
+    
+    const auto key = state.getProperty("encryptionKey").toString();
+    const auto path = state.getProperty("samplePath").toString();
+    {
+        const ScopedLock sl(sourceLock);
+        restoredKey = key;
+        if (File::isAbsolutePath(path)) {
+            restoredFile = File(path);
+            restoredHash = state.getProperty("sampleHash").toString();
+            hasRestoredSample = true;
+        }
+    }
+    triggerAsyncUpdate();
 }
 
-void JUCECB::encryptAudioECB(AudioBuffer<float>& buffer, const String& key)
+void JUCECB::applyRestoredState()
 {
-    // Calculate RMS of original signal first
-    float originalRMS = 0.0f;
-    int totalSamples = buffer.getNumSamples() * buffer.getNumChannels();
+    String key;
+    File file;
+    String hash;
+    bool recall = false;
+    {
+        const ScopedLock sl(sourceLock);
+        key = std::move(restoredKey);
+        restoredKey = {};
+        recall = hasRestoredSample;
+        hasRestoredSample = false;
+        file = restoredFile;
+        hash = restoredHash;
+    }
     
-    for (int channel = 0; channel < buffer.getNumChannels(); channel++) {
-        const float* data = buffer.getReadPointer(channel);
-        for (int i = 0; i < buffer.getNumSamples(); i++) {
-            originalRMS += data[i] * data[i];
+    if (key.isNotEmpty() && key != encryptionKey) {
+        encKeyParameter->setKeyText(key);
+    }
+    if (recall) {
+        recallSample(file, hash);
+    }
+}
+
+void JUCECB::recallSample(const File& file, const String& contentHash)
+{
+    {
+        const ScopedLock sl(sourceLock);
+        sessionFile = file;
+        sessionHash = contentHash;
+        
+        // Same sample as before, e.g. undoing a preset change: the key and
+        // quantize settings re-encrypt it through their own listeners, and
+        // the encryption cache usually still has the result
+        if (loadedSource != nullptr && loadedSource->file == file
+            && SampleLoader::hashToString(loadedSource->contentHash) == contentHash) {
+            return;
         }
     }
-    originalRMS = std::sqrt(originalRMS / totalSamples);
     
-    // First normalize the input to prevent clipping during conversion
-    float maxAbs = 0.0f;
-    for (int channel = 0; channel < buffer.getNumChannels(); channel++) {
-        const float* data = buffer.getReadPointer(channel);
-        for (int i = 0; i < buffer.getNumSamples(); i++) {
-            maxAbs = std::max(maxAbs, std::abs(data[i]));
-        }
+    if (!file.existsAsFile()) {
+        DBG("Saved sample " + file.getFullPathName() + " is missing");
+        return;
     }
     
-    float normalizeScale = maxAbs > 0.0f ? 0.95f / maxAbs : 1.0f;
+    // Every instance decodes on its own loader thread, so opening a session
+    // with many instances never queues file IO on the message thread
+    sampleLoader.load(file);
+}
+
+bool JUCECB::encryptAudioECB(AudioBuffer<float>& buffer, const String& key, int numLevels,
+                             float originalRMS, float maxAbs,
+                             const EncryptionWorker::AbortCheck& shouldAbort,
+                             int16_t* ciphertext, float* gainUsed)
+{
+    const auto numChannels = buffer.getNumChannels();
+    const auto numSamples = buffer.getNumSamples();
+    const int totalSamples = numSamples * numChannels;
     
-    // Apply normalization before quantization
-    for (int channel = 0; channel < buffer.getNumChannels(); channel++) {
-        float* data = buffer.getWritePointer(channel);
-        for (int i = 0; i < buffer.getNumSamples(); i++) {
-            data[i] *= normalizeScale;
-        }
+    if (totalSamples == 0) {
+        return true;
     }
     
-    // Quantize with safety checks
-    const int numLevels = static_cast<int>(quantizationParameter->load());
-    const float quantizationStep = 1.9f / numLevels; // Slightly less than 2.0 for safety
+    JUCECB_TRACE_SCOPE_VALUE("encryption", "encryptAudioECB", totalSamples);
+    encryptionPool.clearCodebooks();
     
-    for (int channel = 0; channel < buffer.getNumChannels(); channel++) {
-        float* data = buffer.getWritePointer(channel);
-        for (int i = 0; i < buffer.getNumSamples(); i++) {
-            // Clamp input first
-            float clampedInput = std::max(-0.95f, std::min(0.95f, data[i]));
-            // Quantize each sample to nearest level
-            float level = std::round(clampedInput / quantizationStep);
-            data[i] = level * quantizationStep;
-        }
-    }
+    // Every stage runs over the same fixed chunks on the encryption pool.
+    // Chunks are whole cipher blocks, so only a channel's last chunk needs
+    // padding, and the per-chunk sums are merged in chunk order so the result
+    // is the same for any number of threads.
+    constexpr int chunkSamples = EncryptionPool::chunkSamples;
+    const int chunksPerChannel = (numSamples + chunkSamples - 1) / chunkSamples;
+    const int numChunks = chunksPerChannel * numChannels;
     
-    // Generate encryption key
-    std::vector<uint8_t> aesKey(32, 0);
-    for (int i = 0; i < key.length() && i < 32; i++) {
-        aesKey[static_cast<size_t>(i)] = key[i];
-    }
+    auto getChunk = [&] (int chunk, int& length) {
+        const int start = (chunk % chunksPerChannel) * chunkSamples;
+        length = jmin(chunkSamples, numSamples - start);
+        return buffer.getWritePointer(chunk / chunksPerChannel) + start;
+    };
     
-    const auto numChannels = buffer.getNumChannels();
-    const auto numSamples = buffer.getNumSamples();
+    std::vector<EncryptionPool::Lane::ChunkResult> stats(static_cast<size_t>(numChunks));
     
-    // Process each channel
-    for (int channel = 0; channel < numChannels; channel++) {
-        float* data = buffer.getWritePointer(channel);
-        
-        // Convert float samples to 16-bit integers with safety scaling
-        std::vector<int16_t> intSamples(static_cast<size_t>(numSamples));
-        for (int i = 0; i < numSamples; i++) {
-            // Scale to slightly less than full int16_t range for safety
-            float scaledSample = data[i] * 30000.0f;  // Using 30000 instead of 32767
-            intSamples[static_cast<size_t>(i)] = static_cast<int16_t>(std::round(scaledSample));
-        }
-        
-        // Convert to bytes for encryption
-        std::vector<uint8_t> bytes(intSamples.size() * sizeof(int16_t));
-        memcpy(bytes.data(), intSamples.data(), bytes.size());
-        
-        // Pad to AES block size
-        const size_t padding = bytes.size() % AES_BLOCK_SIZE;
-        if (padding != 0) {
-            const size_t paddingSize = AES_BLOCK_SIZE - padding;
-            bytes.resize(bytes.size() + paddingSize, static_cast<uint8_t>(paddingSize));
+    // Normalize the input to prevent clipping during conversion
+    const float normalizeScale = maxAbs > 0.0f ? 0.95f / maxAbs : 1.0f;
+    const float quantizationStep = 1.9f / numLevels; // Slightly less than 2.0 for safety
+    
+    // Normalize, quantize, encrypt and convert back each chunk. Each side of
+    // the cipher is a single fused pass; the way back also measures the
+    // encrypted signal.
+    encryptionPool.forEachChunk(numChunks, [&] (int chunk, EncryptionPool::Lane& lane) {
+        if (shouldAbort()) {
+            return;
         }
         
-        // Encrypt the bytes
-        std::vector<uint8_t> encryptedBytes = encryptBlockECB(bytes, aesKey);
-        
-        // Convert encrypted bytes back to int16_t samples
-        std::vector<int16_t> encryptedSamples(static_cast<size_t>(numSamples));
-        memcpy(encryptedSamples.data(), encryptedBytes.data(),
-               std::min(encryptedBytes.size(), encryptedSamples.size() * sizeof(int16_t)));
+        JUCECB_TRACE_SCOPE_VALUE("encryption", "encryptChunk", chunk);
         
-        // Convert back to float with safety scaling
-        for (int i = 0; i < numSamples; i++) {
-            data[i] = static_cast<float>(encryptedSamples[static_cast<size_t>(i)]) / 30000.0f;
-        }
-    }
+        // Each distinct block goes through AES once, via the lane's codebook
+        int length = 0;
+        float* data = getChunk(chunk, length);
+        int16_t* chunkCiphertext = ciphertext != nullptr
+            ? ciphertext + (chunk / chunksPerChannel) * static_cast<int64>(numSamples) + (chunk % chunksPerChannel) * chunkSamples
+            : nullptr;
+        stats[static_cast<size_t>(chunk)] = lane.encryptChunk(data, length, key, normalizeScale, quantizationStep,
+                                                              chunkCiphertext);
+    });
     
-    // Calculate RMS of encrypted signal
-    float encryptedRMS = 0.0f;
-    for (int channel = 0; channel < buffer.getNumChannels(); channel++) {
-        const float* data = buffer.getReadPointer(channel);
-        for (int i = 0; i < buffer.getNumSamples(); i++) {
-            encryptedRMS += data[i] * data[i];
-        }
+    if (shouldAbort()) {
+        return false;
     }
-    encryptedRMS = std::sqrt(encryptedRMS / totalSamples);
     
     // Apply normalization with safety limits
-    if (encryptedRMS > 0.0f) {
-        const float targetRMS = std::min(originalRMS, 0.25f); // Limit maximum RMS
-        const float gainFactor = targetRMS / encryptedRMS;
-        const float safeGainFactor = std::min(gainFactor, 2.0f); // Limit maximum gain
-        
-        for (int channel = 0; channel < buffer.getNumChannels(); channel++) {
-            float* data = buffer.getWritePointer(channel);
-            for (int i = 0; i < buffer.getNumSamples(); i++) {
-                data[i] *= safeGainFactor;
-            }
-        }
+    int64 encryptedSumOfSquares = 0;
+    int64 numBlocks = 0;
+    int64 numBlocksEncrypted = 0;
+    for (const auto& chunk : stats) {
+        encryptedSumOfSquares += chunk.encryptedSumOfSquares;
+        numBlocks += chunk.numBlocks;
+        numBlocksEncrypted += chunk.numBlocksEncrypted;
     }
     
-    // Final safety check - hard clip anything that somehow got through
-    for (int channel = 0; channel < buffer.getNumChannels(); channel++) {
-        float* data = buffer.getWritePointer(channel);
-        for (int i = 0; i < buffer.getNumSamples(); i++) {
-            data[i] = std::max(-1.0f, std::min(1.0f, data[i]));
-        }
-    }
-}
+    const float hitRate = numBlocks > 0 ? 1.0f - static_cast<float>(numBlocksEncrypted) / numBlocks : 0.0f;
+    codebookHitRate.store(hitRate);
 
-std::vector<uint8_t> JUCECB::encryptBlockECB(const std::vector<uint8_t>& data, const std::vector<uint8_t>& key)
-{
-    std::vector<uint8_t> encrypted(data.size() + AES_BLOCK_SIZE);
-    
-    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
-    if (!ctx) {
-        return encrypted;
+    const float safeGainFactor = getEncryptedGain(originalRMS, encryptedSumOfSquares, totalSamples);
+    if (gainUsed != nullptr) {
+        *gainUsed = safeGainFactor;
     }
     
-    EVP_CIPHER_CTX_set_padding(ctx, 0);
-    
-    if (EVP_EncryptInit_ex(ctx, EVP_aes_256_ecb(), nullptr, key.data(), nullptr) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
-        return encrypted;
-    }
-    
-    int outlen1 = 0;
-    int outlen2 = 0;
-    
-    if (EVP_EncryptUpdate(ctx,
-                          encrypted.data(),
-                          &outlen1,
-                          data.data(),
-                          static_cast<int>(data.size())) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
-        return encrypted;
-    }
-    
-    if (EVP_EncryptFinal_ex(ctx, encrypted.data() + outlen1, &outlen2) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
-        return encrypted;
-    }
+    encryptionPool.forEachChunk(numChunks, [&] (int chunk, EncryptionPool::Lane&) {
+        JUCECB_TRACE_SCOPE_VALUE("encryption", "applyGain", chunk);
+        int length = 0;
+        float* data = getChunk(chunk, length);
+        
+        // Final safety check - hard clip anything that somehow got through
+        EncryptionKernels::applyGainAndClip(data, length, safeGainFactor);
+    });
     
-    EVP_CIPHER_CTX_free(ctx);
-    encrypted.resize(static_cast<size_t>(outlen1 + outlen2));
-    return encrypted;
+    return !shouldAbort();
 }
 
 void JUCECB::loadFile()
@@ -635,45 +915,37 @@ void JUCECB::loadFile()
             return;
         }
         
-        std::unique_ptr<AudioFormatReader> reader(formatManager.createReaderFor(file));
-        
-        if (reader != nullptr)
-        {
-            auto numSamples = reader->lengthInSamples;  // Store length to avoid repeated access
-            
-            // Convert to mono if necessary
-            originalBuffer.setSize(1, static_cast<int>(numSamples));
-            if (reader->numChannels == 1)
-            {
-                reader->read(&originalBuffer, 0, static_cast<int>(numSamples), 0, true, true);
-            }
-            else
-            {
-                // Mix down to mono
-                AudioBuffer<float> tempBuffer(static_cast<int>(reader->numChannels), static_cast<int>(numSamples));
-                reader->read(&tempBuffer, 0, static_cast<int>(numSamples), 0, true, true);
-                
-                // Average all channels
-                originalBuffer.clear();
-                for (int channel = 0; channel < static_cast<int>(reader->numChannels); channel++)
-                {
-                    originalBuffer.addFrom(0, 0, tempBuffer, channel, 0,
-                        static_cast<int>(numSamples), 1.0f/reader->numChannels);
-                }
+        // Decoded in the background, so long files never block the UI
+        sampleLoader.load(file);
+    });
+}
+
+bool JUCECB::loadFileAndWait(const File& file, int timeoutMs)
+{
+    const auto deadline = Time::getMillisecondCounter() + static_cast<uint32>(timeoutMs);
+    auto waitUntil = [deadline] (auto&& isDone) {
+        while (!isDone()) {
+            if (Time::getMillisecondCounter() > deadline) {
+                return false;
             }
-            
-            // Create encrypted buffer (mono)
-            encryptedBuffer.setSize(1, static_cast<int>(numSamples));
-            encryptedBuffer.copyFrom(0, 0, originalBuffer, 0, 0, originalBuffer.getNumSamples());
-            
-            // Encrypt the buffer with quantization
-            encryptAudioECB(encryptedBuffer, encryptionKey);
-            
-            hasLoadedFile = true;
-            currentSamplePosition = 0;
-            DBG("File loaded successfully in mono");
+            Thread::sleep(1);
         }
-    });
+        return true;
+    };
+    
+    sampleLoader.load(file);
+    if (!waitUntil([this] { return !sampleLoader.isLoading(); })) {
+        sampleLoader.cancel();
+        return false;
+    }
+    
+    // Adopt the source here, since nothing dispatches the async update
+    handleUpdateNowIfNeeded();
+    if (loadedSource == nullptr || loadedSource->file != file) {
+        return false;
+    }
+    
+    return waitUntil([this] { return !encryptionWorker.isBusy(); });
 }
 
 bool JUCECB::isValidWavFile(const File& file)
@@ -687,27 +959,185 @@ bool JUCECB::isValidWavFile(const File& file)
 
 void JUCECB::reloadWithNewKey()
 {
+    JUCECB_TRACE_SCOPE("encryption", "reloadWithNewKey");
+    
     // Only proceed if we have a file loaded
     if (!hasLoadedFile) {
         return;
     }
     
-    // Stop any playing notes
-    for (auto& voice : voices) {
-        voice.isActive = false;
+    // Re-encrypt in the background; playing voices crossfade to the result
+    requestEncryption();
+    
+    currentSamplePosition = 0;
+    DBG("Reloading with new key: " + encryptionKey);
+}
+
+void JUCECB::applyEncryptionKey(const String& newKey)
+{
+    {
+        const ScopedLock sl(sourceLock);
+        encryptionKey = newKey;
+    }
+    liveEffect.setKey(newKey);
+    if (hasLoadedFile) {
+        reloadWithNewKey();
+    }
+}
+
+void JUCECB::requestEncryption(int delayMs)
+{
+    // Replaces any rebuild still queued or running, so only the latest
+    // key and quantize setting is ever encrypted
+    JUCECB_TRACE_SCOPE("encryption", "requestEncryption");
+    requestedQuantize = static_cast<int>(quantizationParameter->load());
+    encryptionWorker.request(loadedSource, encryptionKey, requestedQuantize, sampleStorage.load(), delayMs);
+}
+
+float JUCECB::getEncryptedGain(float originalRMS, juce::int64 encryptedSumOfSquares, juce::int64 numSamples)
+{
+    const double int16Scale = EncryptionKernels::int16Scale;
+    const float encryptedRMS = static_cast<float>(std::sqrt(static_cast<double>(encryptedSumOfSquares)
+                                                            / (int16Scale * int16Scale) / numSamples));
+    float safeGainFactor = 1.0f;
+    if (encryptedRMS > 0.0f) {
+        const float targetRMS = std::min(originalRMS, 0.25f); // Limit maximum RMS
+        const float gainFactor = targetRMS / encryptedRMS;
+        safeGainFactor = std::min(gainFactor, 2.0f); // Limit maximum gain
+    }
+    return safeGainFactor;
+}
+
+SampleSet::Ptr JUCECB::buildSampleSet(const SampleSource::Ptr& source, const String& key, int numLevels,
+                                      const EncryptionWorker::AbortCheck& shouldAbort)
+{
+    const auto storage = sampleStorage.load();
+    if (source->isStreamed()) {
+        auto set = buildStreamedSampleSet(source, key, numLevels, shouldAbort);
+        if (set != nullptr) {
+            set->storage = storage;
+        }
+        return set;
+    }
+    
+    const bool storeAsInt16 = storage != SampleStorage::float32;
+    
+    // Another session or instance may have encrypted this audio already
+    {
+        JUCECB_TRACE_SCOPE("encryption", "diskCacheLoad");
+        if (auto cached = diskCache.load(source, key, numLevels, storeAsInt16)) {
+            cached->storage = storage;
+            return cached;
+        }
     }
-    voices.clear();
     
-    // Create new encrypted version with the new key
-    encryptedBuffer.clear();
-    encryptedBuffer.setSize(originalBuffer.getNumChannels(), originalBuffer.getNumSamples());
-    encryptedBuffer.copyFrom(0, 0, originalBuffer, 0, 0, originalBuffer.getNumSamples());
+    SampleSet::Ptr set = new SampleSet(source, key, numLevels);
+    set->storage = storage;
     
-    // Encrypt with new key
-    encryptAudioECB(encryptedBuffer, encryptionKey);
+    // Encrypt only the real samples, not the guard samples. The ciphertext
+    // is kept for the disk cache and int16 storage.
+    AudioBuffer<float> encryptedSamples(set->encrypted.getArrayOfWritePointers(), 1, source->length);
+    HeapBlock<int16_t> ciphertext;
+    if (diskCache.isEnabled() || storeAsInt16) {
+        ciphertext.allocate(static_cast<size_t>(source->length), false);
+    }
+    float gain = 1.0f;
+    if (!encryptAudioECB(encryptedSamples, key, numLevels, source->rms, source->peak, shouldAbort,
+                         ciphertext.getData(), &gain)) {
+        return nullptr;
+    }
     
-    currentSamplePosition = 0;
-    DBG("Reloaded with new key: " + encryptionKey);
+    set->bakeLoopTail();
+    if (ciphertext != nullptr) {
+        JUCECB_TRACE_SCOPE("encryption", "diskCacheStore");
+        diskCache.store(*set, ciphertext.getData(), gain);
+    }
+    if (storeAsInt16) {
+        set->storeAsInt16(ciphertext.getData(), gain);
+    }
+    return set;
+}
+
+SampleSet::Ptr JUCECB::buildStreamedSampleSet(const SampleSource::Ptr& source, const String& key, int numLevels,
+                                              const EncryptionWorker::AbortCheck& shouldAbort)
+{
+    JUCECB_TRACE_SCOPE("encryption", "buildStreamedSampleSet");
+    encryptionPool.clearCodebooks();
+    constexpr int pageSamples = SampleStream::pageSamples;
+    auto& stream = *source->stream;
+    const float normalizeScale = source->peak > 0.0f ? 0.95f / source->peak : 1.0f;
+    const float quantizationStep = 1.9f / numLevels;
+    
+    // The gain depends on the level of the whole encrypted sample, which
+    // is estimated from evenly spaced pages rather than encrypting it all
+    const int numPages = static_cast<int>((source->length + pageSamples - 1) / pageSamples);
+    const int numProbes = jmin(STREAM_GAIN_PROBE_PAGES, numPages);
+    HeapBlock<float> probeData(static_cast<size_t>(numProbes) * pageSamples);
+    std::vector<int64> probeSums(static_cast<size_t>(numProbes), 0);
+    std::vector<int64> probeLengths(static_cast<size_t>(numProbes), 0);
+    
+    encryptionPool.forEachChunk(numProbes, [&] (int probe, EncryptionPool::Lane& lane) {
+        if (shouldAbort()) {
+            return;
+        }
+        
+        const int64 start = static_cast<int64>(probe) * numPages / numProbes * pageSamples;
+        const int length = static_cast<int>(jmin(int64(pageSamples), source->length - start));
+        float* data = probeData.getData() + static_cast<size_t>(probe) * pageSamples;
+        stream.read(start, length, data);
+        
+        probeSums[static_cast<size_t>(probe)] = lane.encryptChunk(data, length, key, normalizeScale,
+                                                                  quantizationStep).encryptedSumOfSquares;
+        probeLengths[static_cast<size_t>(probe)] = length;
+    });
+    
+    if (shouldAbort()) {
+        return nullptr;
+    }
+    
+    const float gain = getEncryptedGain(source->rms,
+                                        std::accumulate(probeSums.begin(), probeSums.end(), int64(0)),
+                                        std::accumulate(probeLengths.begin(), probeLengths.end(), int64(0)));
+    
+    // Encrypt the head in page-sized chunks, then the block after it, which
+    // provides its guard samples, exactly like the pages themselves
+    SampleSet::Ptr set = new SampleSet(source, key, numLevels);
+    float* head = set->encrypted.getWritePointer(0);
+    const int headLength = source->headLength;
+    const int numHeadPages = (headLength + pageSamples - 1) / pageSamples;
+    const int guardLength = static_cast<int>(jmin(int64(SampleStream::blockSamples), source->length - headLength));
+    
+    encryptionPool.forEachChunk(numHeadPages + 1, [&] (int chunk, EncryptionPool::Lane& lane) {
+        const int start = jmin(chunk * pageSamples, headLength);
+        const int length = chunk < numHeadPages ? jmin(pageSamples, headLength - start) : guardLength;
+        if (length > 0) {
+            lane.encryptChunk(head + start, length, key, normalizeScale, quantizationStep);
+        }
+    });
+    EncryptionKernels::applyGainAndClip(head, headLength + guardLength, gain);
+    
+    // Encrypt the end of the file from the block the loop tail starts in
+    const int crossfadeLength = source->crossfadeLength;
+    const int64 endStart = (source->length - crossfadeLength) / SampleStream::blockSamples * SampleStream::blockSamples;
+    const int endLength = static_cast<int>(source->length - endStart);
+    std::vector<float> end(static_cast<size_t>(endLength));
+    stream.read(endStart, endLength, end.data());
+    
+    encryptionPool.forEachChunk(1, [&] (int, EncryptionPool::Lane& lane) {
+        lane.encryptChunk(end.data(), endLength, key, normalizeScale, quantizationStep);
+    });
+    EncryptionKernels::applyGainAndClip(end.data(), endLength, gain);
+    set->bakeLoopTail(end.data() + (endLength - crossfadeLength));
+    
+    // Page in the rest on demand, starting with whatever the voices were
+    // playing from the previous encryption of this file
+    const auto playingPages = sampleStreamer.getLoadedPages(stream);
+    set->pager = std::make_unique<SamplePager>(sampleStreamer, stream,
+                                               SamplePager::Settings { key, normalizeScale, quantizationStep, gain });
+    set->pager->preload(playingPages, encryptionPool);
+    
+    DBG("Streaming " + String(source->length) + " samples, gain estimated from " + String(numProbes) + " pages");
+    return set;
 }
 
 AudioProcessor* JUCE_CALLTYPE createPluginFilter()
@@ -12,11 +12,24 @@
 #include <openssl/evp.h>
 #include <openssl/aes.h>
 #include <openssl/err.h>
+#include "EncryptionKernels.h"
+#include "EncryptionPool.h"
+#include "EncryptionWorker.h"
+#include "LiveEcbEffect.h"
+#include "LoadMeter.h"
+#include "SampleLoader.h"
+#include "SampleSet.h"
+#include "SampleSetDiskCache.h"
+#include "Telemetry.h"
+#include "Tracing.h"
+#include "VoicePool.h"
+#include "VoiceRenderer.h"
 
 //==============================================================================
 /**
  */
-class JUCECB  : public juce::AudioProcessor, public AudioProcessorParameter::Listener
+class JUCECB  : public juce::AudioProcessor, public AudioProcessorParameter::Listener,
+                private AudioProcessorValueTreeState::Listener, private AsyncUpdater
 {
     public:
     //==============================================================================
@@ -58,93 +71,80 @@ class JUCECB  : public juce::AudioProcessor, public AudioProcessorParameter::Lis
     
     // Custom public methods
     void loadFile();
+    
+    // Files are decoded on a background thread; the editor polls these
+    float getLoadProgress() const { return sampleLoader.getProgress(); }
+    bool isLoading() const { return sampleLoader.isLoading(); }
+    void cancelLoading() { sampleLoader.cancel(); }
+    
+    // Loads a file and waits until its encryption is published, for offline
+    // hosts without a message loop such as the tools in Tools/. Blocks the
+    // caller; returns false if loading failed or timed out.
+    bool loadFileAndWait(const File& file, int timeoutMs = 60000);
+    
+    // Maximum simultaneous voices, up to VoicePool::capacity. Only change it
+    // while not processing.
+    void setPolyphony(int newPolyphony) { voices.setPolyphony(newPolyphony); }
+    int getPolyphony() const { return voices.getPolyphony(); }
+    // Message thread
     void setEncryptionKey(const String& newKey) {
         if (newKey != encryptionKey) {
-            encryptionKey = newKey;
-            if (hasLoadedFile) {
-                reloadWithNewKey();
-            }
+            applyEncryptionKey(newKey);
         }
     }
     String getCurrentKey() const { return encryptionKey; }
+    void setTelemetryLevel(TelemetryLevel newLevel) { telemetry.setLevel(newLevel); }
+    
+    // Encrypts buffer in place. Normally called by the encryption worker;
+    // public so the tools in Tools/ can time it. Only one thread may call it
+    // at a time, as it shares the encryption pool.
+    bool encryptAudioECB(AudioBuffer<float>& buffer, const String& key, int numLevels,
+                         float originalRMS, float maxAbs,
+                         const EncryptionWorker::AbortCheck& shouldAbort,
+                         int16_t* ciphertext = nullptr, float* gainUsed = nullptr);
+    
+    // Gain that brings the encrypted signal back to the original level
+    static float getEncryptedGain(float originalRMS, juce::int64 encryptedSumOfSquares, juce::int64 numSamples);
+    int getEncryptionThreads() const { return encryptionPool.getNumThreads(); }
+    
+    // Share of ECB blocks in the last encryption that came from the codebook
+    // instead of the cipher
+    float getCodebookHitRate() const { return codebookHitRate.load(); }
+    
+    // Cache of previously encrypted key/quantize combinations
+    SampleSetCache::Statistics getEncryptionCacheStatistics() const { return encryptionWorker.getCache().getStatistics(); }
+    void setEncryptionCacheBudget(size_t budgetBytes) { encryptionWorker.getCache().setBudget(budgetBytes); }
+    
+    // Audio thread load against the block deadline; the editor polls these
+    LoadMeter::Statistics getLoadStatistics() const { return loadMeter.getStatistics(); }
+    float takePeakLoad() { return loadMeter.takePeakLoad(); }
+    void resetLoadStatistics() { loadMeter.requestReset(); }
+    
+    // Writes the recent trace markers of every thread in the process as a
+    // Chrome trace. Empty unless built with JUCECB_TRACING.
+    bool writeTrace(const File& file) const { return Tracing::writeChromeTrace(file); }
+    
+    // On-disk cache of encrypted samples, shared by every instance
+    SampleSetDiskCache::Statistics getDiskCacheStatistics() const { return diskCache.getStatistics(); }
+    void setDiskCacheBudget(juce::int64 budgetBytes) { diskCache.setBudget(budgetBytes); }
+    void setDiskCacheEnabled(bool shouldBeEnabled) { diskCache.setEnabled(shouldBeEnabled); }
+    
+    // Holding samples as int16 halves their memory and the render loop's
+    // memory traffic. Applies from the next load or encryption.
+    void setSampleStorage(SampleStorage newStorage)
+    {
+        sampleStorage = newStorage;
+        sampleLoader.setStoreAsInt16(newStorage == SampleStorage::int16All);
+    }
+    SampleStorage getSampleStorage() const { return sampleStorage.load(); }
     void stopNote();
     void startNote();
     
-    struct Voice {
-        int midiNote;
-        double samplePosition;
-        double basePlaybackRate;
-        double playbackRate;
-        float velocity;
-        bool isActive;
-        
-        // Envelope parameters
-        float attackTime = 0.01f;     // Attack time in seconds
-        float releaseTime = 0.15f;    // Release time in seconds
-        float releaseLevel = 1.0f;    // Level when note off was triggered
-        double releaseStart = 0;      // Sample position when note off was triggered
-        double attackStart = 0;       // Sample position when note started
-        bool isReleasing = false;
-        double sampleRate = 44100.0;
-        int bufferLength = 0;
-        static constexpr float crossfadeLength = 64; // samples
-        static constexpr int XFADE_LENGTH = 512; // Longer crossfade for smoother transitions
-        float previousSample = 0.0f; // Store last sample for interpolation
-        
-        Voice(int note, double rate, float vel, double sr, int buffLen)
-        : midiNote(note),
-        samplePosition(0.0),
-        basePlaybackRate(rate),
-        playbackRate(rate),
-        velocity(vel),
-        isActive(true),
-        attackStart(0),
-        sampleRate(sr),
-        bufferLength(buffLen) {}
-        
-        float getEnvelopeGain(double currentSamplePos) {
-            // Attack phase
-            float attackGain = 1.0f;
-            double timeSinceAttack = (currentSamplePos - attackStart) / sampleRate;
-            if (timeSinceAttack < 0) {
-                timeSinceAttack += bufferLength / sampleRate;
-            }
-            
-            if (timeSinceAttack < attackTime) {
-                // Cubic curve for attack
-                float t = timeSinceAttack / attackTime;
-                attackGain = t * t * (3.0f - 2.0f * t); // Smooth cubic interpolation
-            }
-            
-            // Release phase
-            float releaseGain = 1.0f;
-            if (isReleasing) {
-                double timeSinceRelease = (currentSamplePos - releaseStart) / sampleRate;
-                if (timeSinceRelease < 0) {
-                    timeSinceRelease += bufferLength / sampleRate;
-                }
-                
-                if (timeSinceRelease >= releaseTime) {
-                    isActive = false;
-                    return 0.0f;
-                }
-
-                float t = timeSinceRelease / releaseTime;
-                releaseGain = std::pow(1.0f - t, 2.0f); // Quadratic decay
-            }
-            
-            return attackGain * releaseGain;
-        }
-        
-        void triggerRelease() {
-            isReleasing = true;
-            releaseStart = samplePosition;
-            // If releaseStart is beyond the buffer length, wrap it
-            while (releaseStart >= bufferLength) {
-                releaseStart -= bufferLength;
-            }
-        }
-    };
+    static constexpr int XFADE_LENGTH = 512; // Loop crossfade / end fade length in samples
+    static constexpr double KEY_XFADE_SECONDS = 0.05; // Crossfade to a newly encrypted sample
+    static constexpr double STREAM_READ_AHEAD_SECONDS = 1.0; // Streamed pages requested ahead of each voice
+    static constexpr int STREAM_READ_AHEAD_PAGES = 4;        // ...but never more pages than this
+    static constexpr int STREAM_GAIN_PROBE_PAGES = 32;       // Pages encrypted to estimate a streamed sample's gain
     
     class TextParameter : public juce::AudioProcessorParameter
     {
@@ -188,8 +188,7 @@ class JUCECB  : public juce::AudioProcessor, public AudioProcessorParameter::Lis
     {
         if (auto* param = dynamic_cast<TextParameter*>(parameters.getParameter("enckey"))) {
             if (param->getParameterIndex() == parameterIndex) {
-                encryptionKey = param->getKeyText();
-                reloadWithNewKey();
+                applyEncryptionKey(param->getKeyText());
             }
         }
     }
@@ -204,10 +203,51 @@ class JUCECB  : public juce::AudioProcessor, public AudioProcessorParameter::Lis
     // Audio format handling
     juce::AudioFormatManager formatManager;
     
-    // Encryption methods
-    void encryptAudioECB(AudioBuffer<float>& buffer, const String& key);
-    std::vector<uint8_t> encryptBlockECB(const std::vector<uint8_t>& data, const std::vector<uint8_t>& key);
+    // Encryption methods. These run on the encryption worker.
+    SampleSet::Ptr buildSampleSet(const SampleSource::Ptr& source, const String& key, int numLevels,
+                                  const EncryptionWorker::AbortCheck& shouldAbort);
+    SampleSet::Ptr buildStreamedSampleSet(const SampleSource::Ptr& source, const String& key, int numLevels,
+                                          const EncryptionWorker::AbortCheck& shouldAbort);
     void reloadWithNewKey();
+    void applyEncryptionKey(const String& newKey);
+    void requestEncryption(int delayMs = EncryptionWorker::debounceMs);
+    
+    // Cipher contexts for the encryption worker; the threads behind it are
+    // shared by every instance in the process
+    EncryptionPool encryptionPool;
+    
+    // Encryptions kept across sessions and instances
+    SampleSetDiskCache diskCache;
+    std::atomic<SampleStorage> sampleStorage { SampleStorage::float32 };
+    std::atomic<float> codebookHitRate { 0.0f };
+    
+    // Rendering
+    void renderBlock(AudioBuffer<float>& buffer, MidiBuffer& midiMessages, juce::int64 blockStart);
+    void handleMidiEvent(const MidiMessage& msg, juce::int64 eventTime);
+    void beginSampleSetTransition();
+    void renderVoices(float* output, int numSamples);
+    void renderVoiceChunk(const SampleSet& set, int voice, double& runOrigin, int chunkStart, int chunkLength,
+                          bool loopEnabled, float dryMix, float wetMix, float* dest);
+    void requestReadAhead(const SampleSet& set, double position, double rate);
+    
+    // Live input, quantize changes and finished loads. The latency is
+    // reported and the sample re-encrypted from the message thread, so
+    // changes from any thread are handed over asynchronously; a burst of
+    // automation coalesces into one update.
+    void processLiveInput(AudioBuffer<float>& buffer);
+    bool isLiveInputEnabled() const { return liveInputParameter->load() > 0.5f; }
+    void updateLatency();
+    void parameterChanged(const String& parameterID, float newValue) override;
+    void handleAsyncUpdate() override;
+    void adoptLoadedSource();
+    
+    // Session recall. The state stores the sample's path and content hash;
+    // restoring it loads the file in the background, or keeps the loaded
+    // source if it already holds the same sample. setStateInformation may
+    // run on any thread, so it only stashes the key and the sample, and
+    // they are applied on the message thread.
+    void applyRestoredState();
+    void recallSample(const File& file, const String& contentHash);
     
     // File handling methods
     AudioBuffer<float> getAudioBufferFromFile(juce::File file);
@@ -217,8 +257,32 @@ class JUCECB  : public juce::AudioProcessor, public AudioProcessorParameter::Lis
     // Playback state
     bool hasLoadedFile = false;
     int currentSamplePosition = 0;
-    AudioBuffer<float> originalBuffer;
-    AudioBuffer<float> encryptedBuffer;
+    
+    // Sample data. The message thread owns the loaded source; the audio
+    // thread only reads the sets published through sampleSets, and
+    // crossfades from previous() to current() when only the key changed.
+    // The streamer pages in streamed sources and must outlive every set.
+    SampleStreamer sampleStreamer;
+    SampleSource::Ptr loadedSource;
+    SampleLoader sampleLoader;
+    SampleSource::Ptr pendingSource; // Finished by the loader, not yet adopted
+    
+    // The sample the session refers to, even while it is still loading.
+    // Hosts save and restore state from any thread, so this, pendingSource
+    // and assignments to loadedSource are guarded by sourceLock.
+    File sessionFile;
+    String sessionHash;
+    juce::CriticalSection sourceLock;
+    
+    // Restored state not yet applied on the message thread, guarded by sourceLock
+    String restoredKey;
+    File restoredFile;
+    String restoredHash;
+    bool hasRestoredSample = false;
+    SampleSetExchange sampleSets;
+    EncryptionWorker encryptionWorker;
+    int sampleSetFadeLength = 2048;
+    int sampleSetFadePosition = 0;
     
     // Pitch control
     double playbackRate = 1.0;
@@ -228,15 +292,23 @@ class JUCECB  : public juce::AudioProcessor, public AudioProcessorParameter::Lis
     std::atomic<float>* wetDryParameter = nullptr;
     
     // Polyphony
-    std::vector<Voice> voices;
+    VoicePool voices;
+    
+    // Per-chunk render scratch, preallocated so processBlock never touches the heap
+    alignas(32) std::array<float, VoiceRenderer::chunkSize> renderScratch {};
+    alignas(32) std::array<float, VoiceRenderer::chunkSize> envelopeScratch {};
+    alignas(32) std::array<float, VoiceRenderer::chunkSize> fadeScratch {};
+    int renderChunkSize = VoiceRenderer::chunkSize;
     
     // Quantization
     std::atomic<float>* quantizationParameter = nullptr;
+    int requestedQuantize = -1; // Of the last encryption request, message thread only
     
     // Pitch wheel
     std::atomic<float>* pitchBendRangeParameter = nullptr;
     
-    // Encryption key
+    // Encryption key. Written on the message thread under sourceLock, so
+    // getStateInformation can read it from any thread.
     TextParameter* encKeyParameter = nullptr;
     String encryptionKey = "DefaultKey123";
     
@@ -249,8 +321,16 @@ class JUCECB  : public juce::AudioProcessor, public AudioProcessorParameter::Lis
     // Looping
     std::atomic<float>* loopEnabledParameter = nullptr;
     
+    // Live input effect, in place of the sampler
+    std::atomic<float>* liveInputParameter = nullptr;
+    LiveEcbEffect liveEffect;
+    bool liveInputWasEnabled = false; // Audio thread only
+    
     // Logging
     std::unique_ptr<FileLogger> fileLogger;
+    Telemetry telemetry;
+    juce::int64 processedSamples = 0; // Timestamp for telemetry events
+    LoadMeter loadMeter;
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (JUCECB)
 };
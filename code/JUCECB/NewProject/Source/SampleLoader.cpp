@@ -0,0 +1,219 @@
+/*
+ ==============================================================================
+
+ Background thread that decodes sample files.
+
+ ==============================================================================
+ */
+
+#include "SampleLoader.h"
+#include "EncryptionKernels.h"
+#include "Tracing.h"
+
+//==============================================================================
+SampleLoader::SampleLoader(AudioFormatManager& formatManagerToUse, int maxCrossfadeLengthToUse, Callback onLoadedToUse)
+: Thread("JUCECB Loader"),
+  formatManager(formatManagerToUse),
+  maxCrossfadeLength(maxCrossfadeLengthToUse),
+  onLoaded(std::move(onLoadedToUse))
+{
+}
+
+SampleLoader::~SampleLoader()
+{
+    stop();
+}
+
+void SampleLoader::start()
+{
+    if (!isThreadRunning()) {
+        startThread(Priority::background);
+    }
+}
+
+void SampleLoader::stop()
+{
+    generation++; // Abort whatever is running
+    stopThread(4000);
+}
+
+void SampleLoader::load(const File& file)
+{
+    {
+        const ScopedLock sl(requestLock);
+        generation++; // Supersedes whatever is queued or running
+        nextFile = file;
+        hasRequest = true;
+        progress = 0.0f;
+    }
+    notify();
+}
+
+void SampleLoader::cancel()
+{
+    const ScopedLock sl(requestLock);
+    generation++;
+    nextFile = File();
+    hasRequest = false;
+    progress = -1.0f;
+}
+
+void SampleLoader::run()
+{
+    while (!threadShouldExit()) {
+        File file;
+        uint32_t jobGeneration = 0;
+
+        {
+            const ScopedLock sl(requestLock);
+            if (hasRequest) {
+                file = nextFile;
+                hasRequest = false;
+                jobGeneration = generation.load();
+            }
+        }
+
+        if (file == File()) {
+            wait(-1);
+            continue;
+        }
+
+        const AbortCheck shouldAbort = [this, jobGeneration] {
+            return threadShouldExit() || generation.load(std::memory_order_relaxed) != jobGeneration;
+        };
+
+        SampleSource::Ptr source;
+        {
+            JUCECB_TRACE_SCOPE("loading", "loadFile");
+            source = loadSource(file, shouldAbort);
+        }
+        if (source == nullptr && !shouldAbort()) {
+            DBG("Could not load " + file.getFullPathName());
+        }
+
+        // Checked under the lock, so a cancel can't slip in between
+        const ScopedLock sl(requestLock);
+        if (source != nullptr && !shouldAbort()) {
+            source->file = file;
+            onLoaded(source);
+        }
+        if (!hasRequest) {
+            progress = -1.0f;
+        }
+    }
+}
+
+juce::uint64 SampleLoader::hashSamples(const float* samples, int numSamples, juce::uint64 hash) noexcept
+{
+    // FNV-1a over the sample bits, a word at a time
+    for (int i = 0; i < numSamples; i++) {
+        uint32_t bits;
+        std::memcpy(&bits, samples + i, sizeof(bits));
+        hash = (hash ^ bits) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+//==============================================================================
+SampleSource::Ptr SampleLoader::loadSource(const File& file, const AbortCheck& shouldAbort)
+{
+    std::unique_ptr<AudioFormatReader> reader;
+    {
+        JUCECB_TRACE_SCOPE("loading", "openReader");
+        reader.reset(formatManager.createReaderFor(file));
+    }
+    if (reader == nullptr) {
+        return nullptr;
+    }
+
+    const auto numSamples = reader->lengthInSamples;
+    if (numSamples < minSamples) {
+        return nullptr;
+    }
+    if (numSamples > SampleStream::streamingThresholdSamples) {
+        // Too long to hold in memory: stream it from the file instead
+        reader.reset();
+        return loadStreamedSource(file, shouldAbort);
+    }
+
+    // Convert to mono if necessary, leaving guard samples after the end
+    const int numChannels = static_cast<int>(reader->numChannels);
+    const int length = static_cast<int>(numSamples);
+    AudioBuffer<float> monoBuffer(1, length + VoiceRenderer::guardSamples);
+    AudioBuffer<float> block(numChannels, blockSamples);
+    monoBuffer.clear();
+    juce::uint64 hash = initialHash;
+
+    for (int start = 0; start < length; start += blockSamples) {
+        if (shouldAbort()) {
+            return nullptr;
+        }
+
+        const int blockLength = jmin(blockSamples, length - start);
+        {
+            JUCECB_TRACE_SCOPE_VALUE("loading", "decode", start / blockSamples);
+            if (numChannels == 1) {
+                reader->read(&monoBuffer, start, blockLength, start, true, true);
+            } else {
+                // Average all channels
+                reader->read(&block, 0, blockLength, start, true, true);
+                for (int channel = 0; channel < numChannels; channel++) {
+                    monoBuffer.addFrom(0, start, block, channel, 0, blockLength, 1.0f / numChannels);
+                }
+            }
+        }
+        {
+            JUCECB_TRACE_SCOPE("loading", "hash");
+            hash = hashSamples(monoBuffer.getReadPointer(0, start), blockLength, hash);
+        }
+        progress = static_cast<float>(start + blockLength) / static_cast<float>(length);
+    }
+
+    JUCECB_TRACE_SCOPE("loading", "prepareSource");
+    SampleSource::Ptr source = new SampleSource(std::move(monoBuffer), length, maxCrossfadeLength);
+    source->contentHash = hash;
+    if (storeAsInt16) {
+        source->storeAsInt16();
+    }
+    return source;
+}
+
+SampleSource::Ptr SampleLoader::loadStreamedSource(const File& file, const AbortCheck& shouldAbort)
+{
+    JUCECB_TRACE_SCOPE("loading", "loadStreamedSource");
+    auto stream = SampleStream::open(formatManager, file);
+    if (stream == nullptr) {
+        return nullptr;
+    }
+
+    // Measure the level page by page, so memory doesn't grow with the file
+    const juce::int64 length = stream->getLength();
+    if (length < minSamples) {
+        return nullptr;
+    }
+    HeapBlock<float> page(static_cast<size_t>(blockSamples));
+    double sumOfSquares = 0.0;
+    float peak = 0.0f;
+    juce::uint64 hash = initialHash;
+
+    for (juce::int64 start = 0; start < length; start += blockSamples) {
+        if (shouldAbort()) {
+            return nullptr;
+        }
+
+        const int blockLength = static_cast<int>(jmin(juce::int64(blockSamples), length - start));
+        {
+            JUCECB_TRACE_SCOPE_VALUE("loading", "decode", static_cast<int>(start / blockSamples));
+            stream->read(start, blockLength, page.getData());
+        }
+        JUCECB_TRACE_SCOPE("loading", "measureAndHash");
+        EncryptionKernels::measure(page.getData(), blockLength, sumOfSquares, peak);
+        hash = hashSamples(page.getData(), blockLength, hash);
+        progress = static_cast<float>(static_cast<double>(start + blockLength) / static_cast<double>(length));
+    }
+
+    const float rms = length > 0 ? static_cast<float>(std::sqrt(sumOfSquares / static_cast<double>(length))) : 0.0f;
+    SampleSource::Ptr source = new SampleSource(std::move(stream), maxCrossfadeLength, rms, peak);
+    source->contentHash = hash;
+    return source;
+}
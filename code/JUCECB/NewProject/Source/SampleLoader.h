@@ -0,0 +1,77 @@
+/*
+ ==============================================================================
+
+ Background thread that decodes sample files.
+
+ Loading reads the file in page-sized blocks, mixing down to mono as it
+ goes, and reports its progress after every block. Streamed files are
+ scanned for their level the same way. Both passes also hash the decoded
+ samples, so a saved session can tell whether its file still holds the
+ same sample. A new load or cancel() stops the one in progress at the next
+ block. Finished sources are handed to a callback on the loader thread;
+ from there they go to the encryption worker and reach the audio thread
+ through SampleSetExchange, so the message thread never blocks on a file
+ and nothing the audio thread reads is ever resized.
+
+ ==============================================================================
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "SampleSet.h"
+
+//==============================================================================
+class SampleLoader : private juce::Thread
+{
+    public:
+    static constexpr int blockSamples = SampleStream::pageSamples;
+    static constexpr int minSamples = 2; // Anything shorter has nothing to loop
+
+    // Called on the loader thread with every source that finished loading
+    using Callback = std::function<void (SampleSource::Ptr source)>;
+
+    SampleLoader(AudioFormatManager& formatManagerToUse, int maxCrossfadeLengthToUse, Callback onLoadedToUse);
+    ~SampleLoader() override;
+
+    void start();
+    void stop();
+
+    // Replaces any load that is queued or running
+    void load(const File& file);
+    void cancel();
+
+    // Between 0 and 1 while loading, negative otherwise
+    float getProgress() const noexcept { return progress.load(); }
+    bool isLoading() const noexcept { return getProgress() >= 0.0f; }
+
+    // Store the samples of files that aren't streamed as int16, see
+    // SampleStorage. Applies from the next load.
+    void setStoreAsInt16(bool shouldStoreAsInt16) { storeAsInt16 = shouldStoreAsInt16; }
+
+    // Folds samples into a running content hash, starting from initialHash
+    static constexpr juce::uint64 initialHash = 0xcbf29ce484222325ull;
+    static juce::uint64 hashSamples(const float* samples, int numSamples, juce::uint64 hash) noexcept;
+    static String hashToString(juce::uint64 hash) { return String::toHexString(static_cast<juce::int64>(hash)); }
+
+    private:
+    using AbortCheck = std::function<bool()>;
+
+    void run() override;
+    SampleSource::Ptr loadSource(const File& file, const AbortCheck& shouldAbort);
+    SampleSource::Ptr loadStreamedSource(const File& file, const AbortCheck& shouldAbort);
+
+    AudioFormatManager& formatManager;
+    const int maxCrossfadeLength;
+    Callback onLoaded;
+
+    juce::CriticalSection requestLock;
+    File nextFile;
+    bool hasRequest = false;
+
+    std::atomic<uint32_t> generation { 0 };
+    std::atomic<float> progress { -1.0f };
+    std::atomic<bool> storeAsInt16 { false };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SampleLoader)
+};
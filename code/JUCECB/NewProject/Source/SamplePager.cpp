@@ -0,0 +1,273 @@
+/*
+ ==============================================================================
+
+ Lazily encrypted pages of a streamed sample.
+
+ ==============================================================================
+ */
+
+#include "SamplePager.h"
+#include "EncryptionKernels.h"
+#include "Tracing.h"
+
+//==============================================================================
+SamplePager::SamplePager(SampleStreamer& streamerToUse, SampleStream& streamToUse, Settings settingsToUse)
+: streamer(streamerToUse),
+  stream(streamToUse),
+  settings(std::move(settingsToUse)),
+  numPages(static_cast<int>((streamToUse.getLength() + pageSamples - 1) / pageSamples))
+{
+    for (auto& slot : slots) {
+        slot.dry.allocate(static_cast<size_t>(SampleStream::maxReadSamples), true);
+        slot.wet.allocate(static_cast<size_t>(SampleStream::maxReadSamples), true);
+    }
+    streamer.add(this);
+}
+
+SamplePager::~SamplePager()
+{
+    streamer.remove(this);
+}
+
+size_t SamplePager::getSizeInBytes() const noexcept
+{
+    return numSlots * 2 * static_cast<size_t>(SampleStream::maxReadSamples) * sizeof(float);
+}
+
+//==============================================================================
+const SamplePager::Page* SamplePager::acquire(int page) noexcept
+{
+    for (auto& slot : slots) {
+        auto state = slot.state.load(std::memory_order_acquire);
+
+        // Fails only if the streamer evicted the slot in between
+        while ((state >> pinBits) == page + 1) {
+            if (slot.state.compare_exchange_weak(state, state + 1, std::memory_order_acquire)) {
+                const auto now = useClock.load(std::memory_order_relaxed) + 1;
+                useClock.store(now, std::memory_order_relaxed);
+                slot.lastUsed.store(now, std::memory_order_relaxed);
+                return &slot;
+            }
+        }
+    }
+
+    misses++;
+    requestRange(static_cast<double>(page) * pageSamples, static_cast<double>(page + 1) * pageSamples);
+    return nullptr;
+}
+
+void SamplePager::release(const Page* slot) noexcept
+{
+    slot->state.fetch_sub(1, std::memory_order_release);
+}
+
+void SamplePager::requestRange(double start, double end) noexcept
+{
+    const int firstPage = jmax(0, static_cast<int>(start / pageSamples));
+    const int lastPage = jmin(numPages - 1, static_cast<int>(std::ceil(end / pageSamples)) - 1);
+
+    for (int page = firstPage; page <= lastPage; page++) {
+        if (isLoaded(page)) {
+            continue;
+        }
+
+        // A full FIFO drops the request; it is repeated next block
+        const auto scope = requestFifo.write(1);
+        if (scope.blockSize1 > 0) {
+            requests[static_cast<size_t>(scope.startIndex1)] = page;
+        } else if (scope.blockSize2 > 0) {
+            requests[static_cast<size_t>(scope.startIndex2)] = page;
+        } else {
+            return;
+        }
+    }
+}
+
+bool SamplePager::isLoaded(int page) const noexcept
+{
+    for (const auto& slot : slots) {
+        if ((slot.state.load(std::memory_order_relaxed) >> pinBits) == page + 1) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//==============================================================================
+void SamplePager::preload(const Array<int>& pages, EncryptionPool& pool)
+{
+    const int numToLoad = jmin(numSlots, pages.size());
+    pool.forEachChunk(numToLoad, [&] (int i, EncryptionPool::Lane& lane) {
+        loadPage(slots[static_cast<size_t>(i)], pages[i], lane);
+    });
+}
+
+void SamplePager::service(EncryptionPool::Lane& lane)
+{
+    std::array<int, requestCapacity> pending;
+    int numPending = 0;
+
+    const auto scope = requestFifo.read(requestFifo.getNumReady());
+    for (int i = 0; i < scope.blockSize1; i++) {
+        pending[static_cast<size_t>(numPending++)] = requests[static_cast<size_t>(scope.startIndex1 + i)];
+    }
+    for (int i = 0; i < scope.blockSize2; i++) {
+        pending[static_cast<size_t>(numPending++)] = requests[static_cast<size_t>(scope.startIndex2 + i)];
+    }
+
+    for (int i = 0; i < numPending; i++) {
+        const int page = pending[static_cast<size_t>(i)];
+        if (isLoaded(page)) {
+            continue; // Asked for more than once
+        }
+
+        const int victim = findVictim();
+        if (victim < 0) {
+            return; // Every slot is being read
+        }
+
+        // Take the slot over, unless the audio thread pinned it meanwhile
+        auto& slot = slots[static_cast<size_t>(victim)];
+        auto state = slot.state.load();
+        if ((state & pinMask) != 0 || !slot.state.compare_exchange_strong(state, 0)) {
+            continue;
+        }
+
+        loadPage(slot, page, lane);
+    }
+}
+
+int SamplePager::findVictim() const noexcept
+{
+    const auto now = useClock.load(std::memory_order_relaxed);
+    int victim = -1;
+    uint32_t oldestAge = 0;
+
+    for (int i = 0; i < numSlots; i++) {
+        const auto& slot = slots[static_cast<size_t>(i)];
+        const auto state = slot.state.load(std::memory_order_relaxed);
+        if (state == 0) {
+            return i;
+        }
+
+        const uint32_t age = now - slot.lastUsed.load(std::memory_order_relaxed);
+        if ((state & pinMask) == 0 && (victim < 0 || age > oldestAge)) {
+            victim = i;
+            oldestAge = age;
+        }
+    }
+    return victim;
+}
+
+void SamplePager::loadPage(Page& slot, int page, EncryptionPool::Lane& lane)
+{
+    JUCECB_TRACE_SCOPE_VALUE("loading", "loadPage", page);
+    const juce::int64 start = juce::int64(page) * pageSamples;
+    const juce::int64 remaining = stream.getLength() - start;
+    const int length = static_cast<int>(jmin(juce::int64(pageSamples), remaining));
+    const int guardLength = static_cast<int>(jlimit(juce::int64(0), juce::int64(SampleStream::blockSamples),
+                                                    remaining - length));
+
+    float* dry = slot.dry.getData();
+    float* wet = slot.wet.getData();
+    {
+        JUCECB_TRACE_SCOPE("loading", "readPage");
+        stream.read(start, SampleStream::maxReadSamples, dry);
+    }
+    std::copy(dry, dry + SampleStream::maxReadSamples, wet);
+
+    // The guard samples are the next page's first block, encrypted on its own
+    lane.encryptChunk(wet, length, settings.key, settings.normalizeScale, settings.quantizationStep);
+    if (guardLength > 0) {
+        lane.encryptChunk(wet + length, guardLength, settings.key, settings.normalizeScale,
+                          settings.quantizationStep);
+    }
+    EncryptionKernels::applyGainAndClip(wet, length + guardLength, settings.gain);
+
+    slot.lastUsed.store(useClock.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    slot.state.store(stateFor(page), std::memory_order_release);
+}
+
+Array<int> SamplePager::getLoadedPages() const
+{
+    const auto now = useClock.load(std::memory_order_relaxed);
+    std::vector<std::pair<uint32_t, int>> loaded; // Age, page
+
+    for (const auto& slot : slots) {
+        const auto page = static_cast<int>(slot.state.load() >> pinBits) - 1;
+        if (page >= 0) {
+            loaded.emplace_back(now - slot.lastUsed.load(std::memory_order_relaxed), page);
+        }
+    }
+    std::sort(loaded.begin(), loaded.end());
+
+    Array<int> pages;
+    for (const auto& entry : loaded) {
+        pages.add(entry.second);
+    }
+    return pages;
+}
+
+//==============================================================================
+SampleStreamer::SampleStreamer()
+: Thread("JUCECB Streaming")
+{
+}
+
+SampleStreamer::~SampleStreamer()
+{
+    stop();
+}
+
+void SampleStreamer::start()
+{
+    if (!isThreadRunning()) {
+        startThread(Priority::high);
+    }
+}
+
+void SampleStreamer::stop()
+{
+    stopThread(4000);
+}
+
+void SampleStreamer::add(SamplePager* pager)
+{
+    const ScopedLock sl(lock);
+    pagers.addIfNotAlreadyThere(pager);
+}
+
+void SampleStreamer::remove(SamplePager* pager)
+{
+    // Waits for the pager's pages to finish loading
+    const ScopedLock sl(lock);
+    pagers.removeFirstMatchingValue(pager);
+}
+
+Array<int> SampleStreamer::getLoadedPages(const SampleStream& stream) const
+{
+    const ScopedLock sl(lock);
+    Array<int> pages;
+
+    for (auto* pager : pagers) {
+        if (&pager->getStream() == &stream) {
+            for (int page : pager->getLoadedPages()) {
+                pages.addIfNotAlreadyThere(page);
+            }
+        }
+    }
+    return pages;
+}
+
+void SampleStreamer::run()
+{
+    while (!threadShouldExit()) {
+        {
+            const ScopedLock sl(lock);
+            for (auto* pager : pagers) {
+                pager->service(lane);
+            }
+        }
+        wait(intervalMs);
+    }
+}
@@ -0,0 +1,136 @@
+/*
+ ==============================================================================
+
+ Lazily encrypted pages of a streamed sample, for one key and quantize
+ setting.
+
+ A pager owns a fixed number of page slots, each holding one page of the
+ original and encrypted samples plus guard samples, so its memory doesn't
+ depend on the length of the file. The audio thread pins the page it reads
+ with a compare-and-swap on the slot state and asks for pages it will need
+ soon through a lock-free FIFO. The SampleStreamer thread reads and
+ encrypts those pages into the least recently used unpinned slots.
+
+ Pages are encrypted in the same block-aligned chunks as a loaded sample,
+ so a streamed sample sounds exactly like the same file loaded whole,
+ given the same normalization gain.
+
+ ==============================================================================
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "EncryptionPool.h"
+#include "SampleStream.h"
+
+class SampleStreamer;
+
+//==============================================================================
+class SamplePager
+{
+    public:
+    static constexpr int pageSamples = SampleStream::pageSamples;
+    static constexpr int numSlots = 32;
+    static constexpr int requestCapacity = 128;
+
+    // How a page is turned into its encrypted form
+    struct Settings
+    {
+        String key;
+        float normalizeScale = 1.0f;
+        float quantizationStep = 1.0f;
+        float gain = 1.0f;
+    };
+
+    struct Page
+    {
+        // pageSamples followed by the first samples of the next page
+        HeapBlock<float> dry, wet;
+
+        // (page index + 1) << pinBits | pin count; 0 while empty or loading
+        mutable std::atomic<juce::int64> state { 0 };
+        std::atomic<uint32_t> lastUsed { 0 };
+    };
+
+    // Registers with the streamer, which services the pager until it is
+    // destroyed
+    SamplePager(SampleStreamer& streamerToUse, SampleStream& streamToUse, Settings settingsToUse);
+    ~SamplePager();
+
+    // Audio thread. Pins a page and returns its slot, or nullptr if it
+    // isn't loaded yet, in which case it is requested.
+    const Page* acquire(int page) noexcept;
+    void release(const Page* slot) noexcept;
+
+    // Audio thread. Requests every page overlapping [start, end) that isn't
+    // loaded yet.
+    void requestRange(double start, double end) noexcept;
+
+    // Loads pages before the pager is first used, e.g. those another
+    // pager of the same stream was playing from. Not thread safe.
+    void preload(const Array<int>& pages, EncryptionPool& pool);
+
+    // Streamer thread. Loads the pages requested since the last call.
+    void service(EncryptionPool::Lane& lane);
+
+    // Loaded pages, most recently used first
+    Array<int> getLoadedPages() const;
+
+    const SampleStream& getStream() const noexcept { return stream; }
+    int getNumPages() const noexcept { return numPages; }
+    uint32_t getNumMisses() const noexcept { return misses.load(); }
+    size_t getSizeInBytes() const noexcept;
+
+    private:
+    static constexpr int pinBits = 16;
+    static constexpr juce::int64 pinMask = (juce::int64(1) << pinBits) - 1;
+
+    static juce::int64 stateFor(int page) noexcept { return juce::int64(page + 1) << pinBits; }
+    bool isLoaded(int page) const noexcept;
+    int findVictim() const noexcept;
+    void loadPage(Page& slot, int page, EncryptionPool::Lane& lane);
+
+    SampleStreamer& streamer;
+    SampleStream& stream;
+    const Settings settings;
+    const int numPages;
+
+    std::array<Page, numSlots> slots;
+    std::atomic<uint32_t> useClock { 0 };
+    std::atomic<uint32_t> misses { 0 };
+
+    juce::AbstractFifo requestFifo { requestCapacity };
+    std::array<int, requestCapacity> requests {};
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SamplePager)
+};
+
+//==============================================================================
+// Background read-ahead thread shared by every pager of a plugin instance
+class SampleStreamer : private juce::Thread
+{
+    public:
+    static constexpr int intervalMs = 5;
+
+    SampleStreamer();
+    ~SampleStreamer() override;
+
+    void start();
+    void stop();
+
+    void add(SamplePager* pager);
+    void remove(SamplePager* pager);
+
+    // Pages loaded by any pager of the stream, most recently used first
+    Array<int> getLoadedPages(const SampleStream& stream) const;
+
+    private:
+    void run() override;
+
+    juce::CriticalSection lock;
+    juce::Array<SamplePager*> pagers;
+    EncryptionPool::Lane lane;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SampleStreamer)
+};
@@ -0,0 +1,231 @@
+/*
+ ==============================================================================
+
+ Immutable sample data shared between the message, worker and audio threads.
+
+ ==============================================================================
+ */
+
+#include "SampleSet.h"
+#include "EncryptionKernels.h"
+
+namespace
+{
+    // Bakes a loop tail for a sample that isn't held whole, from its first
+    // crossfadeLength + guardSamples and its last crossfadeLength samples
+    void bakeJoinedLoopTail(const float* head, const float* end, int crossfadeLength, float* tail)
+    {
+        const int headSamples = crossfadeLength + VoiceRenderer::guardSamples;
+        std::vector<float> joined(static_cast<size_t>(headSamples + crossfadeLength));
+        std::copy(head, head + headSamples, joined.begin());
+        std::copy(end, end + crossfadeLength, joined.begin() + headSamples);
+        VoiceRenderer::bakeLoopTail(joined.data(), static_cast<int>(joined.size()), crossfadeLength, tail);
+    }
+}
+
+//==============================================================================
+SampleSource::SampleSource(AudioBuffer<float>&& monoSamples, int numSamples, int maxCrossfadeLength)
+: samples(std::move(monoSamples)),
+  length(numSamples),
+  headLength(numSamples)
+{
+    jassert(samples.getNumSamples() >= length + VoiceRenderer::guardSamples);
+
+    // The loop wraps from the end back to crossfadeLength, so the loop needs
+    // at least that much material before the crossfade region.
+    crossfadeLength = jmin(maxCrossfadeLength, numSamples / 2);
+
+    loopTail.setSize(1, crossfadeLength + VoiceRenderer::guardSamples);
+    VoiceRenderer::bakeLoopTail(samples.getReadPointer(0), numSamples, crossfadeLength,
+                                loopTail.getWritePointer(0));
+
+    double sumOfSquares = 0.0;
+    EncryptionKernels::measure(samples.getReadPointer(0), numSamples, sumOfSquares, peak);
+    rms = length > 0 ? static_cast<float>(std::sqrt(sumOfSquares / length)) : 0.0f;
+}
+
+SampleSource::SampleSource(std::unique_ptr<SampleStream> streamToUse, int maxCrossfadeLength,
+                           float rmsLevel, float peakLevel)
+: length(streamToUse->getLength()),
+  stream(std::move(streamToUse)),
+  rms(rmsLevel),
+  peak(peakLevel)
+{
+    static_assert(VoiceRenderer::guardSamples <= SampleStream::blockSamples,
+                  "The block after the head must cover the guard samples");
+
+    constexpr int pageSamples = SampleStream::pageSamples;
+    headLength = static_cast<int>(jmin(length, juce::int64(streamedHeadPages) * pageSamples));
+    crossfadeLength = static_cast<int>(jmin(juce::int64(maxCrossfadeLength), length / 2));
+    jassert(crossfadeLength + VoiceRenderer::guardSamples <= headLength);
+
+    // The head, plus the next block so its last sample can be interpolated
+    samples.setSize(1, headLength + SampleStream::blockSamples);
+    float* head = samples.getWritePointer(0);
+    for (int start = 0; start < samples.getNumSamples(); start += pageSamples) {
+        stream->read(start, jmin(pageSamples, samples.getNumSamples() - start), head + start);
+    }
+
+    std::vector<float> end(static_cast<size_t>(crossfadeLength));
+    stream->read(length - crossfadeLength, crossfadeLength, end.data());
+    loopTail.setSize(1, crossfadeLength + VoiceRenderer::guardSamples);
+    bakeJoinedLoopTail(head, end.data(), crossfadeLength, loopTail.getWritePointer(0));
+}
+
+void SampleSource::storeAsInt16()
+{
+    jassert(!isStreamed() && !isInt16());
+    const int numSamples = samples.getNumSamples();
+    const float* data = samples.getReadPointer(0);
+
+    // Full scale is the peak, so quiet samples keep their resolution
+    samples16Scale = peak > 0.0f ? peak / 32767.0f : 1.0f;
+    samples16.allocate(static_cast<size_t>(numSamples), false);
+    for (int i = 0; i < numSamples; i++) {
+        samples16[i] = static_cast<int16_t>(jlimit(-32767, 32767, roundToInt(data[i] / samples16Scale)));
+    }
+
+    samples = AudioBuffer<float>();
+}
+
+VoiceRenderer::Samples SampleSource::getSamples() const
+{
+    // Originals never clip
+    return isInt16() ? VoiceRenderer::Samples(samples16.getData(), samples16Scale, std::numeric_limits<float>::max())
+                     : VoiceRenderer::Samples(samples.getReadPointer(0));
+}
+
+//==============================================================================
+SampleSet::SampleSet(SampleSource::Ptr sourceToUse, const String& keyUsed, int quantizeUsed)
+: source(std::move(sourceToUse)),
+  key(keyUsed),
+  quantize(quantizeUsed)
+{
+    if (source->isInt16()) {
+        const auto original = source->getSamples();
+        const int numSamples = source->headLength + VoiceRenderer::guardSamples;
+        encrypted.setSize(1, numSamples);
+        float* data = encrypted.getWritePointer(0);
+        for (int i = 0; i < numSamples; i++) {
+            data[i] = original[i];
+        }
+    } else {
+        encrypted.makeCopyOf(source->samples);
+    }
+}
+
+void SampleSet::bakeLoopTail()
+{
+    jassert(!source->isStreamed());
+    encryptedTail.setSize(1, source->loopTail.getNumSamples());
+    VoiceRenderer::bakeLoopTail(encrypted.getReadPointer(0), source->headLength, source->crossfadeLength,
+                                encryptedTail.getWritePointer(0));
+}
+
+void SampleSet::bakeLoopTail(const float* encryptedEnd)
+{
+    encryptedTail.setSize(1, source->loopTail.getNumSamples());
+    bakeJoinedLoopTail(encrypted.getReadPointer(0), encryptedEnd, source->crossfadeLength,
+                       encryptedTail.getWritePointer(0));
+}
+
+void SampleSet::storeAsInt16(const int16_t* ciphertext, float gain)
+{
+    jassert(!source->isStreamed() && encryptedTail.getNumSamples() > 0);
+    const int numSamples = source->headLength;
+
+    // The guard samples stay silent, like the float ones
+    encrypted16.calloc(static_cast<size_t>(numSamples + VoiceRenderer::guardSamples));
+    std::copy(ciphertext, ciphertext + numSamples, encrypted16.getData());
+    encrypted16Scale = gain / EncryptionKernels::int16Scale;
+
+    encrypted = AudioBuffer<float>();
+}
+
+VoiceRenderer::Samples SampleSet::getEncryptedSamples() const
+{
+    // Clipped like applyGainAndClip
+    return encrypted16 != nullptr ? VoiceRenderer::Samples(encrypted16.getData(), encrypted16Scale, 1.0f)
+                                  : VoiceRenderer::Samples(encrypted.getReadPointer(0));
+}
+
+//==============================================================================
+SampleSetExchange::~SampleSetExchange()
+{
+    collectGarbage();
+    release(pending.exchange(nullptr));
+    release(currentSet);
+    release(previousSet);
+}
+
+void SampleSetExchange::publish(SampleSet::Ptr set)
+{
+    // The reference is handed over with the raw pointer
+    if (set != nullptr) {
+        set->incReferenceCount();
+    }
+    release(pending.exchange(set.get()));
+}
+
+void SampleSetExchange::collectGarbage()
+{
+    const ScopedLock sl(collectLock);
+    const auto scope = releaseFifo.read(releaseFifo.getNumReady());
+
+    for (int i = 0; i < scope.blockSize1; i++) {
+        release(released[static_cast<size_t>(scope.startIndex1 + i)]);
+    }
+    for (int i = 0; i < scope.blockSize2; i++) {
+        release(released[static_cast<size_t>(scope.startIndex2 + i)]);
+    }
+}
+
+bool SampleSetExchange::update() noexcept
+{
+    // Adopting retires at most previousSet now and currentSet at the end of
+    // the transition; wait until there is room for both.
+    if (pending.load(std::memory_order_relaxed) == nullptr || releaseFifo.getFreeSpace() < 2) {
+        return false;
+    }
+
+    auto* next = pending.exchange(nullptr, std::memory_order_acquire);
+    if (next == nullptr) {
+        return false;
+    }
+
+    if (previousSet != nullptr) {
+        retire(previousSet);
+    }
+    previousSet = currentSet;
+    currentSet = next;
+    return true;
+}
+
+void SampleSetExchange::endTransition() noexcept
+{
+    // If the FIFO is full the set stays alive and the caller tries again
+    if (previousSet != nullptr && retire(previousSet)) {
+        previousSet = nullptr;
+    }
+}
+
+bool SampleSetExchange::retire(SampleSet* set) noexcept
+{
+    const auto scope = releaseFifo.write(1);
+
+    if (scope.blockSize1 > 0) {
+        released[static_cast<size_t>(scope.startIndex1)] = set;
+    } else if (scope.blockSize2 > 0) {
+        released[static_cast<size_t>(scope.startIndex2)] = set;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void SampleSetExchange::release(SampleSet* set)
+{
+    if (set != nullptr) {
+        set->decReferenceCount();
+    }
+}
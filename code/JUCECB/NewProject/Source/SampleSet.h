@@ -0,0 +1,184 @@
+/*
+ ==============================================================================
+
+ Immutable sample data shared between the message, worker and audio threads.
+
+ A SampleSource is one decoded mono sample plus its baked loop tail. A
+ SampleSet pairs a source with one encryption of it. Both are built off the
+ audio thread and never modified after they are published.
+
+ Sample data can be held as int16 with a scale factor instead of floats,
+ which halves its footprint; the render kernels convert it as they read.
+
+ Files too long to hold in memory are streamed instead: the source only
+ keeps the first pages, where every voice starts, and the loop tail, and
+ each set pages the rest in and encrypts it on demand through a
+ SamplePager.
+
+ SampleSetExchange hands sets to the audio thread and takes them back
+ without locks: publishing swaps an atomic pointer, and the audio thread
+ returns the sets it no longer reads through a FIFO. The sets are freed by
+ whoever calls collectGarbage(), never on the audio thread.
+
+ ==============================================================================
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "SamplePager.h"
+#include "SampleStream.h"
+#include "VoiceRenderer.h"
+
+//==============================================================================
+// How in-memory sample data is held. Encrypted samples come out of the
+// cipher as int16 anyway, so storing them that way loses nothing; originals
+// are rounded to 16 bits.
+enum class SampleStorage
+{
+    float32,
+    int16Encrypted,
+    int16All
+};
+
+//==============================================================================
+struct SampleSource : public juce::ReferenceCountedObject
+{
+    using Ptr = juce::ReferenceCountedObjectPtr<SampleSource>;
+
+    // Pages held in memory at the start of a streamed source
+    static constexpr int streamedHeadPages = 2;
+
+    // Takes a mono buffer holding numSamples samples followed by at least
+    // VoiceRenderer::guardSamples of silence, bakes its loop tail and
+    // measures its level.
+    SampleSource(AudioBuffer<float>&& monoSamples, int numSamples, int maxCrossfadeLength);
+
+    // Streams the file. Reads the head and the loop tail; the level has to
+    // be measured beforehand, see SampleLoader.
+    SampleSource(std::unique_ptr<SampleStream> streamToUse, int maxCrossfadeLength, float rmsLevel, float peakLevel);
+
+    bool isStreamed() const { return stream != nullptr; }
+
+    // Replaces the samples with int16 scaled to the peak; the loop tail
+    // stays float. Only for sources that aren't streamed, and only before
+    // the source is shared.
+    void storeAsInt16();
+    bool isInt16() const { return samples16 != nullptr; }
+
+    // The first headLength samples and their guard samples, as stored
+    VoiceRenderer::Samples getSamples() const;
+
+    // While looping, playback wraps from the end back to the loop start and
+    // reads the last crossfadeLength samples from loopTail instead.
+    int getLoopStart() const { return crossfadeLength; }
+    juce::int64 getLoopLength() const { return length - crossfadeLength; }
+
+    // The first headLength samples, followed by guard samples. That is the
+    // whole sample unless it is streamed. Empty once stored as int16.
+    AudioBuffer<float> samples;
+    HeapBlock<int16_t> samples16;
+    float samples16Scale = 1.0f;
+    AudioBuffer<float> loopTail;
+    juce::int64 length = 0;
+    int headLength = 0;
+    int crossfadeLength = 0;
+    std::unique_ptr<SampleStream> stream;
+
+    // Level of the samples. Measured once here, so re-encrypting for a new
+    // key or quantize setting skips that pass.
+    float rms = 0.0f;
+    float peak = 0.0f;
+
+    // Where the samples came from, and a hash of the decoded samples that
+    // identifies them even if the file moves. Set by the loader before the
+    // source is shared.
+    File file;
+    juce::uint64 contentHash = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SampleSource)
+};
+
+//==============================================================================
+struct SampleSet : public juce::ReferenceCountedObject
+{
+    using Ptr = juce::ReferenceCountedObjectPtr<SampleSet>;
+
+    // Starts with encrypted holding a copy of the source samples.
+    SampleSet(SampleSource::Ptr sourceToUse, const String& keyUsed, int quantizeUsed);
+
+    // Call once encrypted holds its final samples. A streamed set also
+    // needs the last crossfadeLength encrypted samples.
+    void bakeLoopTail();
+    void bakeLoopTail(const float* encryptedEnd);
+
+    // Replaces encrypted, once its loop tail is baked, with the ciphertext
+    // it was made from. It reads back as clamp(ciphertext * gain /
+    // int16Scale), like encrypted did, to within float rounding.
+    void storeAsInt16(const int16_t* ciphertext, float gain);
+
+    // The encrypted head and its guard samples, as stored
+    VoiceRenderer::Samples getEncryptedSamples() const;
+
+    const SampleSource::Ptr source;
+    const String key;
+    const int quantize;
+
+    // The storage setting it was built under, so a cached set is only
+    // reused for the same one. Set by the builder before the set is shared.
+    SampleStorage storage = SampleStorage::float32;
+
+    // Laid out exactly like source->samples and source->loopTail
+    AudioBuffer<float> encrypted;
+    AudioBuffer<float> encryptedTail;
+    HeapBlock<int16_t> encrypted16;
+    float encrypted16Scale = 1.0f;
+
+    // Pages in the rest of a streamed source
+    std::unique_ptr<SamplePager> pager;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SampleSet)
+};
+
+//==============================================================================
+class SampleSetExchange
+{
+    public:
+    static constexpr int releaseCapacity = 16;
+
+    SampleSetExchange() = default;
+    ~SampleSetExchange(); // The audio thread must have stopped
+
+    // Any thread but the audio thread. Replaces a set the audio thread
+    // hasn't picked up yet.
+    void publish(SampleSet::Ptr set);
+
+    // Any thread but the audio thread. Frees the sets the audio thread has
+    // finished with.
+    void collectGarbage();
+
+    //==============================================================================
+    // Audio thread only.
+
+    // Picks up a newly published set. The set it replaces stays readable as
+    // previous() until endTransition(). Returns true if current() changed.
+    bool update() noexcept;
+    void endTransition() noexcept;
+
+    SampleSet* current() const noexcept { return currentSet; }
+    SampleSet* previous() const noexcept { return previousSet; }
+
+    private:
+    bool retire(SampleSet* set) noexcept;
+    static void release(SampleSet* set);
+
+    std::atomic<SampleSet*> pending { nullptr };
+    SampleSet* currentSet = nullptr;
+    SampleSet* previousSet = nullptr;
+
+    juce::AbstractFifo releaseFifo { releaseCapacity };
+    std::array<SampleSet*, releaseCapacity> released {};
+    juce::CriticalSection collectLock;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SampleSetExchange)
+};
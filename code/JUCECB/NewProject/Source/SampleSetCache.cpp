@@ -0,0 +1,116 @@
+/*
+ ==============================================================================
+
+ Memory-budgeted LRU cache of encrypted sample sets.
+
+ ==============================================================================
+ */
+
+#include "SampleSetCache.h"
+
+//==============================================================================
+SampleSet::Ptr SampleSetCache::find(const SampleSource::Ptr& source, const String& key, int quantize,
+                                    SampleStorage storage)
+{
+    const ScopedLock sl(lock);
+
+    for (auto& entry : entries) {
+        if (entry.set->source == source && entry.set->quantize == quantize && entry.set->storage == storage
+            && entry.set->key == key) {
+            entry.lastUsed = ++useCounter;
+            hits++;
+            return entry.set;
+        }
+    }
+
+    misses++;
+    return nullptr;
+}
+
+void SampleSetCache::insert(SampleSet::Ptr set)
+{
+    if (set == nullptr) {
+        return;
+    }
+
+    const ScopedLock sl(lock);
+
+    for (auto& entry : entries) {
+        if (entry.set == set) {
+            entry.lastUsed = ++useCounter;
+            return;
+        }
+    }
+
+    Entry entry;
+    entry.set = std::move(set);
+    entry.sizeInBytes = getSizeInBytes(*entry.set);
+    entry.lastUsed = ++useCounter;
+
+    residentBytes += entry.sizeInBytes;
+    entries.push_back(std::move(entry));
+    evictToBudget();
+}
+
+void SampleSetCache::removeSource(const SampleSource::Ptr& source)
+{
+    const ScopedLock sl(lock);
+
+    for (auto it = entries.begin(); it != entries.end();) {
+        if (it->set->source == source) {
+            residentBytes -= it->sizeInBytes;
+            it = entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void SampleSetCache::clear()
+{
+    const ScopedLock sl(lock);
+    entries.clear();
+    residentBytes = 0;
+}
+
+void SampleSetCache::setBudget(size_t newBudgetBytes)
+{
+    const ScopedLock sl(lock);
+    budgetBytes = newBudgetBytes;
+    evictToBudget();
+}
+
+SampleSetCache::Statistics SampleSetCache::getStatistics() const
+{
+    const ScopedLock sl(lock);
+
+    Statistics statistics;
+    statistics.hits = hits;
+    statistics.misses = misses;
+    statistics.residentBytes = residentBytes;
+    statistics.budgetBytes = budgetBytes;
+    statistics.numEntries = static_cast<int>(entries.size());
+    return statistics;
+}
+
+size_t SampleSetCache::getSizeInBytes(const SampleSet& set)
+{
+    auto bufferBytes = [] (const AudioBuffer<float>& buffer) {
+        return static_cast<size_t>(buffer.getNumChannels()) * static_cast<size_t>(buffer.getNumSamples()) * sizeof(float);
+    };
+    const size_t int16Bytes = set.encrypted16 != nullptr
+        ? static_cast<size_t>(set.source->headLength + VoiceRenderer::guardSamples) * sizeof(int16_t)
+        : 0;
+    return bufferBytes(set.encrypted) + bufferBytes(set.encryptedTail) + int16Bytes
+         + (set.pager != nullptr ? set.pager->getSizeInBytes() : 0);
+}
+
+void SampleSetCache::evictToBudget()
+{
+    while (residentBytes > budgetBytes && entries.size() > 1) {
+        auto oldest = std::min_element(entries.begin(), entries.end(),
+                                       [] (const Entry& a, const Entry& b) { return a.lastUsed < b.lastUsed; });
+        residentBytes -= oldest->sizeInBytes;
+        entries.erase(oldest);
+    }
+}
@@ -0,0 +1,71 @@
+/*
+ ==============================================================================
+
+ Memory-budgeted LRU cache of encrypted sample sets.
+
+ Sets are keyed by their source, key text, quantize level and storage
+ setting, so switching back to a key or quantize setting used earlier in
+ the session reuses the finished encryption instead of running it again. Only the encrypted data
+ counts against the budget; the source is shared by every set made from it.
+
+ ==============================================================================
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "SampleSet.h"
+
+//==============================================================================
+class SampleSetCache
+{
+    public:
+    static constexpr size_t defaultBudgetBytes = 256 * 1024 * 1024;
+
+    struct Statistics
+    {
+        uint64 hits = 0;
+        uint64 misses = 0;
+        size_t residentBytes = 0;
+        size_t budgetBytes = 0;
+        int numEntries = 0;
+    };
+
+    SampleSetCache() = default;
+
+    // Returns the cached set and marks it most recently used, or nullptr
+    SampleSet::Ptr find(const SampleSource::Ptr& source, const String& key, int quantize, SampleStorage storage);
+
+    // Adds a set, then evicts least recently used sets until the cache fits
+    // its budget. The newest set is always kept.
+    void insert(SampleSet::Ptr set);
+
+    // Drops every set made from a source, e.g. when another file is loaded
+    void removeSource(const SampleSource::Ptr& source);
+    void clear();
+
+    void setBudget(size_t newBudgetBytes);
+    Statistics getStatistics() const;
+
+    static size_t getSizeInBytes(const SampleSet& set);
+
+    private:
+    void evictToBudget();
+
+    struct Entry
+    {
+        SampleSet::Ptr set;
+        size_t sizeInBytes = 0;
+        uint64 lastUsed = 0;
+    };
+
+    juce::CriticalSection lock;
+    std::vector<Entry> entries;
+    size_t budgetBytes = defaultBudgetBytes;
+    size_t residentBytes = 0;
+    uint64 useCounter = 0;
+    uint64 hits = 0;
+    uint64 misses = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SampleSetCache)
+};
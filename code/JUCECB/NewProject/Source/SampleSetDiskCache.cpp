@@ -0,0 +1,234 @@
+/*
+ ==============================================================================
+
+ Content-addressed on-disk cache of encrypted samples.
+
+ ==============================================================================
+ */
+
+#include "SampleSetDiskCache.h"
+#include "EncryptionKernels.h"
+#include "EncryptionPool.h"
+
+namespace
+{
+    constexpr juce::uint64 fnvOffset = 0xcbf29ce484222325ull;
+    constexpr juce::uint64 fnvPrime = 0x100000001b3ull;
+    const char* const entryExtension = ".ecb";
+}
+
+//==============================================================================
+SampleSetDiskCache::SampleSetDiskCache(const File& directoryToUse)
+: directory(directoryToUse)
+{
+}
+
+File SampleSetDiskCache::getDefaultDirectory()
+{
+    return File::getSpecialLocation(File::userApplicationDataDirectory)
+        .getChildFile("JUCECB")
+        .getChildFile("EncryptedCache");
+}
+
+SampleSet::Ptr SampleSetDiskCache::load(const SampleSource::Ptr& source, const String& key, int quantize,
+                                        bool storeAsInt16)
+{
+    if (!enabled || source->isStreamed()) {
+        return nullptr;
+    }
+
+    Header expected;
+    expected.magic = magic;
+    expected.version = algorithmVersion;
+    expected.contentHash = source->contentHash;
+    expected.keyHash = hashKey(key);
+    expected.numSamples = source->length;
+    expected.quantize = quantize;
+    expected.sourceIsInt16 = source->isInt16() ? 1 : 0;
+
+    const auto file = getEntryFile(expected);
+    MemoryMappedFile mapped(file, MemoryMappedFile::readOnly);
+    if (mapped.getData() == nullptr) {
+        misses++;
+        return nullptr;
+    }
+
+    const auto payloadBytes = static_cast<size_t>(source->length) * sizeof(int16_t);
+    Header header;
+    bool valid = mapped.getSize() == sizeof(Header) + payloadBytes;
+    if (valid) {
+        std::memcpy(&header, mapped.getData(), sizeof(Header));
+        valid = header.magic == expected.magic && header.version == expected.version
+             && header.contentHash == expected.contentHash && header.keyHash == expected.keyHash
+             && header.numSamples == expected.numSamples && header.quantize == expected.quantize
+             && header.sourceIsInt16 == expected.sourceIsInt16;
+    }
+
+    const auto* ciphertext = reinterpret_cast<const int16_t*>(static_cast<const char*>(mapped.getData()) + sizeof(Header));
+    if (!valid || header.checksum != checksum(header, ciphertext, source->length)) {
+        rejected++;
+        file.deleteFile();
+        return nullptr;
+    }
+
+    // Rebuild the floats exactly like encryptAudioECB did
+    SampleSet::Ptr set = new SampleSet(source, key, quantize);
+    float* encrypted = set->encrypted.getWritePointer(0);
+    for (juce::int64 start = 0; start < source->length; start += EncryptionPool::chunkSamples) {
+        const int length = static_cast<int>(jmin(juce::int64(EncryptionPool::chunkSamples), source->length - start));
+        EncryptionKernels::convertFromInt16(ciphertext + start, length, encrypted + start);
+        EncryptionKernels::applyGainAndClip(encrypted + start, length, header.gain);
+    }
+    set->bakeLoopTail();
+    if (storeAsInt16) {
+        set->storeAsInt16(ciphertext, header.gain);
+    }
+
+    // Mark it recently used for eviction
+    file.setLastModificationTime(Time::getCurrentTime());
+    hits++;
+    return set;
+}
+
+void SampleSetDiskCache::store(const SampleSet& set, const int16_t* ciphertext, float gain)
+{
+    const auto& source = *set.source;
+    if (!enabled || source.isStreamed()) {
+        return;
+    }
+
+    Header header;
+    header.magic = magic;
+    header.version = algorithmVersion;
+    header.contentHash = source.contentHash;
+    header.keyHash = hashKey(set.key);
+    header.numSamples = source.length;
+    header.quantize = set.quantize;
+    header.sourceIsInt16 = source.isInt16() ? 1 : 0;
+    header.gain = gain;
+    header.checksum = checksum(header, ciphertext, source.length);
+
+    const auto file = getEntryFile(header);
+    if (!directory.createDirectory()) {
+        return;
+    }
+
+    // Written beside the entry and renamed into place, so other instances
+    // never map a half-written file
+    TemporaryFile temporary(file);
+    {
+        FileOutputStream out(temporary.getFile());
+        if (out.failedToOpen()
+            || !out.write(&header, sizeof(Header))
+            || !out.write(ciphertext, static_cast<size_t>(source.length) * sizeof(int16_t))) {
+            return;
+        }
+        out.flush();
+        if (out.getStatus().failed()) {
+            return;
+        }
+    }
+
+    if (temporary.overwriteTargetFileWithTemporary()) {
+        stores++;
+        evictToBudget(file);
+    }
+}
+
+void SampleSetDiskCache::setBudget(juce::int64 newBudgetBytes)
+{
+    budgetBytes = jmax(juce::int64(0), newBudgetBytes);
+    evictToBudget({});
+}
+
+SampleSetDiskCache::Statistics SampleSetDiskCache::getStatistics() const
+{
+    Statistics statistics;
+    statistics.hits = hits.load();
+    statistics.misses = misses.load();
+    statistics.rejected = rejected.load();
+    statistics.stores = stores.load();
+    statistics.evictions = evictions.load();
+    return statistics;
+}
+
+//==============================================================================
+juce::uint64 SampleSetDiskCache::hashKey(const String& key)
+{
+    juce::uint64 hash = fnvOffset;
+    for (auto* c = key.toRawUTF8(); *c != 0; c++) {
+        hash = (hash ^ static_cast<uint8_t>(*c)) * fnvPrime;
+    }
+    return hash;
+}
+
+juce::uint64 SampleSetDiskCache::checksum(const Header& header, const int16_t* data, juce::int64 numSamples)
+{
+    // FNV-1a over every header field but the checksum, so a damaged gain is
+    // caught too, then the ciphertext four samples at a time
+    uint32_t gainBits;
+    std::memcpy(&gainBits, &header.gain, sizeof(gainBits));
+
+    juce::uint64 hash = fnvOffset;
+    for (auto field : { juce::uint64(header.magic), juce::uint64(header.version), header.contentHash,
+                        header.keyHash, static_cast<juce::uint64>(header.numSamples),
+                        static_cast<juce::uint64>(static_cast<uint32_t>(header.quantize)), juce::uint64(gainBits),
+                        juce::uint64(header.sourceIsInt16), juce::uint64(header.reserved) }) {
+        hash = (hash ^ field) * fnvPrime;
+    }
+
+    juce::int64 i = 0;
+    for (; i + 4 <= numSamples; i += 4) {
+        juce::uint64 word;
+        std::memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * fnvPrime;
+    }
+    for (; i < numSamples; i++) {
+        hash = (hash ^ static_cast<uint16_t>(data[i])) * fnvPrime;
+    }
+    return hash;
+}
+
+File SampleSetDiskCache::getEntryFile(const Header& header) const
+{
+    juce::uint64 name = fnvOffset;
+    for (auto part : { header.contentHash, header.keyHash, static_cast<juce::uint64>(header.quantize),
+                       static_cast<juce::uint64>(header.sourceIsInt16), static_cast<juce::uint64>(header.version) }) {
+        name = (name ^ part) * fnvPrime;
+    }
+    return directory.getChildFile(String::toHexString(static_cast<juce::int64>(name)).paddedLeft('0', 16)
+                                  + entryExtension);
+}
+
+void SampleSetDiskCache::evictToBudget(const File& newest)
+{
+    auto files = directory.findChildFiles(File::findFiles, false, String("*") + entryExtension);
+
+    juce::int64 totalBytes = 0;
+    for (const auto& file : files) {
+        totalBytes += file.getSize();
+    }
+
+    if (totalBytes <= budgetBytes.load()) {
+        return;
+    }
+
+    // Oldest first; a hit refreshes an entry's modification time
+    std::sort(files.begin(), files.end(), [] (const File& a, const File& b) {
+        return a.getLastModificationTime() < b.getLastModificationTime();
+    });
+
+    for (const auto& file : files) {
+        if (totalBytes <= budgetBytes.load()) {
+            break;
+        }
+        if (file == newest) {
+            continue;
+        }
+        const auto size = file.getSize();
+        if (file.deleteFile()) {
+            totalBytes -= size;
+            evictions++;
+        }
+    }
+}
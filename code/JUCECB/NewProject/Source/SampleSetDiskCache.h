@@ -0,0 +1,100 @@
+/*
+ ==============================================================================
+
+ Content-addressed on-disk cache of encrypted samples.
+
+ Entries are keyed by the source's content hash, the key text, the
+ quantize level and algorithmVersion, so any instance that loads the same
+ audio with the same settings - in this session or a later one - can skip
+ the cipher. An entry is a small header followed by the raw int16
+ ciphertext; the float samples are rebuilt from it and the stored gain by
+ the same kernels that produced them, so a cached set is bit-identical to
+ a fresh one. Files are memory-mapped for reading and checksummed, and a
+ damaged or mismatched entry is deleted and treated as a miss.
+
+ Entries are written to a temporary file and renamed into place, so
+ instances sharing the directory never see a partial entry. When the
+ directory grows past its budget the least recently used entries go.
+
+ Streamed sources are never cached here: their sets only ever encrypt the
+ pages that play.
+
+ ==============================================================================
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "SampleSet.h"
+
+//==============================================================================
+class SampleSetDiskCache
+{
+    public:
+    // Bump whenever the encrypted output for the same input changes, so
+    // stale entries are never read
+    static constexpr uint32_t algorithmVersion = 1;
+
+    static constexpr juce::int64 defaultBudgetBytes = juce::int64(1024) * 1024 * 1024;
+
+    struct Statistics
+    {
+        uint64 hits = 0;
+        uint64 misses = 0;
+        uint64 rejected = 0; // Entries that failed their integrity check
+        uint64 stores = 0;
+        uint64 evictions = 0;
+    };
+
+    explicit SampleSetDiskCache(const File& directoryToUse = getDefaultDirectory());
+
+    static File getDefaultDirectory();
+
+    // Returns a finished set (loop tail baked) from the cache, or nullptr.
+    // With storeAsInt16 the set keeps the ciphertext instead of floats.
+    SampleSet::Ptr load(const SampleSource::Ptr& source, const String& key, int quantize, bool storeAsInt16);
+
+    // Stores a set's ciphertext and gain, then evicts old entries until the
+    // directory fits its budget. The new entry is always kept.
+    void store(const SampleSet& set, const int16_t* ciphertext, float gain);
+
+    void setEnabled(bool shouldBeEnabled) { enabled = shouldBeEnabled; }
+    bool isEnabled() const { return enabled.load(); }
+
+    void setBudget(juce::int64 newBudgetBytes);
+    Statistics getStatistics() const;
+
+    private:
+    struct Header
+    {
+        uint32_t magic = 0;
+        uint32_t version = 0;
+        juce::uint64 contentHash = 0;
+        juce::uint64 keyHash = 0;
+        juce::int64 numSamples = 0;
+        int32_t quantize = 0;
+        float gain = 1.0f;
+        juce::uint64 checksum = 0; // Of the other header fields and the ciphertext
+        uint32_t sourceIsInt16 = 0; // The rounded originals can encrypt differently
+        uint32_t reserved = 0;
+    };
+
+    static constexpr uint32_t magic = 0x4243454a; // "JECB"
+
+    static juce::uint64 hashKey(const String& key);
+    static juce::uint64 checksum(const Header& header, const int16_t* data, juce::int64 numSamples);
+    File getEntryFile(const Header& header) const;
+    void evictToBudget(const File& newest);
+
+    const File directory;
+    std::atomic<bool> enabled { true };
+    std::atomic<juce::int64> budgetBytes { defaultBudgetBytes };
+
+    std::atomic<uint64> hits { 0 };
+    std::atomic<uint64> misses { 0 };
+    std::atomic<uint64> rejected { 0 };
+    std::atomic<uint64> stores { 0 };
+    std::atomic<uint64> evictions { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SampleSetDiskCache)
+};
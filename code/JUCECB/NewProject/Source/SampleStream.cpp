@@ -0,0 +1,62 @@
+/*
+ ==============================================================================
+
+ Mono read access to a sample file too long to hold in memory.
+
+ ==============================================================================
+ */
+
+#include "SampleStream.h"
+
+//==============================================================================
+std::unique_ptr<SampleStream> SampleStream::open(AudioFormatManager& formatManager, const File& file)
+{
+    if (auto* format = formatManager.findFormatForFileExtension(file.getFileExtension())) {
+        std::unique_ptr<MemoryMappedAudioFormatReader> mapped(format->createMemoryMappedReader(file));
+
+        // Only the address space is reserved; the OS pages the file in and
+        // out as it is read
+        if (mapped != nullptr && mapped->mapEntireFile()) {
+            return std::unique_ptr<SampleStream>(new SampleStream(std::move(mapped), true));
+        }
+    }
+
+    std::unique_ptr<AudioFormatReader> reader(formatManager.createReaderFor(file));
+    if (reader == nullptr) {
+        return nullptr;
+    }
+    return std::unique_ptr<SampleStream>(new SampleStream(std::move(reader), false));
+}
+
+SampleStream::SampleStream(std::unique_ptr<AudioFormatReader> readerToUse, bool isMapped)
+: reader(std::move(readerToUse)),
+  length(reader->lengthInSamples),
+  memoryMapped(isMapped)
+{
+    scratch.setSize(static_cast<int>(reader->numChannels), maxReadSamples);
+}
+
+bool SampleStream::read(juce::int64 start, int numSamples, float* dest)
+{
+    jassert(numSamples <= maxReadSamples);
+    const ScopedLock sl(readLock);
+
+    const int available = static_cast<int>(jlimit(juce::int64(0), juce::int64(numSamples), length - start));
+    std::fill(dest + available, dest + numSamples, 0.0f);
+    if (available == 0) {
+        return true;
+    }
+
+    if (!reader->read(&scratch, 0, available, start, true, true)) {
+        std::fill(dest, dest + available, 0.0f);
+        return false;
+    }
+
+    // Average all channels
+    const int numChannels = scratch.getNumChannels();
+    FloatVectorOperations::copyWithMultiply(dest, scratch.getReadPointer(0), 1.0f / numChannels, available);
+    for (int channel = 1; channel < numChannels; channel++) {
+        FloatVectorOperations::addWithMultiply(dest, scratch.getReadPointer(channel), 1.0f / numChannels, available);
+    }
+    return true;
+}
@@ -0,0 +1,58 @@
+/*
+ ==============================================================================
+
+ Mono read access to a sample file too long to hold in memory.
+
+ WAV files are memory-mapped where the format allows it, so reading a page
+ costs a copy out of the OS page cache rather than a decode through a file
+ handle; other formats fall back to a normal reader. Reads are serialised,
+ since a reader isn't thread safe, and mix down to mono on the way out.
+
+ Positions are 64-bit throughout, so files beyond 2^31 samples work.
+
+ ==============================================================================
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "EcbCipher.h"
+#include "EncryptionPool.h"
+
+//==============================================================================
+class SampleStream
+{
+    public:
+    // Streamed samples are paged in and encrypted in chunks of this size
+    static constexpr int pageSamples = EncryptionPool::chunkSamples;
+
+    // One cipher block of int16 samples
+    static constexpr int blockSamples = EcbCipher::blockSize / static_cast<int>(sizeof(int16_t));
+
+    // The largest single read
+    static constexpr int maxReadSamples = pageSamples + blockSamples;
+
+    // Files longer than this are streamed instead of loaded
+    static constexpr juce::int64 streamingThresholdSamples = juce::int64(1) << 24;
+
+    // Returns nullptr if the file can't be read
+    static std::unique_ptr<SampleStream> open(AudioFormatManager& formatManager, const File& file);
+
+    juce::int64 getLength() const noexcept { return length; }
+    bool isMemoryMapped() const noexcept { return memoryMapped; }
+
+    // Reads numSamples (at most maxReadSamples) mixed down to mono. Anything
+    // past the end of the file reads as silence.
+    bool read(juce::int64 start, int numSamples, float* dest);
+
+    private:
+    SampleStream(std::unique_ptr<AudioFormatReader> readerToUse, bool isMapped);
+
+    juce::CriticalSection readLock;
+    std::unique_ptr<AudioFormatReader> reader;
+    AudioBuffer<float> scratch;
+    juce::int64 length = 0;
+    bool memoryMapped = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SampleStream)
+};
@@ -0,0 +1,147 @@
+/*
+ ==============================================================================
+
+ Runtime choice between the scalar, SSE2, AVX2 and NEON versions of a
+ kernel set.
+
+ VoiceRenderer and EncryptionKernels each build one table of function
+ pointers per instruction set. SimdDispatch checks what the CPU and the
+ build support and picks the best version; a Dispatcher holds the table
+ currently in use, which benchmarks can override.
+
+ ==============================================================================
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#if JUCE_INTEL
+ #if JUCE_GCC || JUCE_CLANG
+  #define JUCECB_TARGET_AVX2 __attribute__((target("avx2")))
+ #else
+  #define JUCECB_TARGET_AVX2
+ #endif
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+ #define JUCECB_HAS_NEON 1
+#else
+ #define JUCECB_HAS_NEON 0
+#endif
+
+//==============================================================================
+struct SimdDispatch
+{
+    enum class Implementation
+    {
+        automatic,
+        scalar,
+        sse2,
+        avx2,
+        neon
+    };
+
+    static bool isSupported(Implementation implementation)
+    {
+        switch (implementation) {
+            case Implementation::automatic:
+            case Implementation::scalar:
+                return true;
+           #if JUCE_INTEL
+            case Implementation::sse2:
+                return SystemStats::hasSSE2();
+            case Implementation::avx2:
+                return SystemStats::hasAVX2();
+           #endif
+           #if JUCECB_HAS_NEON
+            case Implementation::neon:
+                return true;
+           #endif
+            default:
+                return false;
+        }
+    }
+
+    // The best supported implementation for automatic, otherwise the one asked for
+    static Implementation resolve(Implementation implementation)
+    {
+        if (implementation != Implementation::automatic) {
+            return implementation;
+        }
+
+        for (auto candidate : { Implementation::avx2, Implementation::neon, Implementation::sse2 }) {
+            if (isSupported(candidate)) {
+                return candidate;
+            }
+        }
+        return Implementation::scalar;
+    }
+
+    static const char* getName(Implementation implementation)
+    {
+        switch (implementation) {
+            case Implementation::sse2: return "sse2";
+            case Implementation::avx2: return "avx2";
+            case Implementation::neon: return "neon";
+            default: return "scalar";
+        }
+    }
+
+    // One kernel set's tables; those not built for this target stay nullptr
+    template <typename Table>
+    struct Tables
+    {
+        const Table* scalar = nullptr;
+        const Table* sse2 = nullptr;
+        const Table* avx2 = nullptr;
+        const Table* neon = nullptr;
+    };
+
+    template <typename Table>
+    class Dispatcher
+    {
+        public:
+        explicit Dispatcher(const Tables<Table>& tablesToUse)
+            : tables(tablesToUse),
+              current(resolve(Implementation::automatic)),
+              active(tableFor(current.load())) {}
+
+        const Table& get() const noexcept { return *active.load(std::memory_order_relaxed); }
+
+        // Returns false and keeps the current table if the CPU or build
+        // doesn't support the implementation
+        bool set(Implementation implementation)
+        {
+            if (!isSupported(implementation)) {
+                return false;
+            }
+
+            const auto resolved = resolve(implementation);
+            current.store(resolved);
+            active.store(tableFor(resolved));
+            return true;
+        }
+
+        Implementation getImplementation() const { return current.load(); }
+
+        private:
+        const Table* tableFor(Implementation implementation) const
+        {
+            const Table* table = nullptr;
+            switch (implementation) {
+                case Implementation::sse2: table = tables.sse2; break;
+                case Implementation::avx2: table = tables.avx2; break;
+                case Implementation::neon: table = tables.neon; break;
+                default: break;
+            }
+            return table != nullptr ? table : tables.scalar;
+        }
+
+        const Tables<Table> tables;
+        std::atomic<Implementation> current;
+        std::atomic<const Table*> active;
+
+        JUCE_DECLARE_NON_COPYABLE (Dispatcher)
+    };
+};
@@ -0,0 +1,111 @@
+/*
+ ==============================================================================
+
+ Lock-free telemetry channel for the audio thread.
+
+ ==============================================================================
+ */
+
+#include "Telemetry.h"
+
+//==============================================================================
+Telemetry::Telemetry()
+: Thread("JUCECB Telemetry")
+{
+}
+
+Telemetry::~Telemetry()
+{
+    stop();
+}
+
+void Telemetry::start()
+{
+    if (!isThreadRunning()) {
+        startThread(Priority::background);
+    }
+}
+
+void Telemetry::stop()
+{
+    stopThread(2000);
+    drain(); // Flush whatever the audio thread left behind
+}
+
+void Telemetry::push(const TelemetryEvent& event) noexcept
+{
+    const auto scope = fifo.write(1);
+
+    if (scope.blockSize1 > 0) {
+        events[static_cast<size_t>(scope.startIndex1)] = event;
+    } else if (scope.blockSize2 > 0) {
+        events[static_cast<size_t>(scope.startIndex2)] = event;
+    } else {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void Telemetry::run()
+{
+    while (!threadShouldExit()) {
+        wait(drainIntervalMs);
+        drain();
+    }
+}
+
+void Telemetry::drain()
+{
+    const auto scope = fifo.read(fifo.getNumReady());
+
+    for (int i = 0; i < scope.blockSize1; i++) {
+        Logger::writeToLog(format(events[static_cast<size_t>(scope.startIndex1 + i)]));
+    }
+    for (int i = 0; i < scope.blockSize2; i++) {
+        Logger::writeToLog(format(events[static_cast<size_t>(scope.startIndex2 + i)]));
+    }
+
+    const auto totalDropped = dropped.load();
+    if (totalDropped != droppedReported) {
+        Logger::writeToLog("Warning: telemetry ring overflowed, dropped "
+                           + String(totalDropped - droppedReported) + " events");
+        droppedReported = totalDropped;
+    }
+}
+
+String Telemetry::format(const TelemetryEvent& event)
+{
+    String text("[" + String(event.sampleTime) + "] ");
+
+    switch (event.type) {
+        case TelemetryEvent::Type::noteOn:
+            text << "Note On - Note: " << String(event.note)
+                 << " Velocity: " << String(event.value, 2)
+                 << " Active voices: " << String(event.count);
+            break;
+        case TelemetryEvent::Type::noteOff:
+            text << "Released voice for note: " << String(event.note);
+            break;
+        case TelemetryEvent::Type::noteOffUnmatched:
+            text << "No active voice found for note off: " << String(event.note);
+            break;
+        case TelemetryEvent::Type::voiceSteal:
+            text << "Stealing oldest voice with note: " << String(event.note);
+            break;
+        case TelemetryEvent::Type::voiceCleanup:
+            text << "Cleaned up " << String(event.count) << " voices";
+            break;
+        case TelemetryEvent::Type::peakLevel:
+            text << "Warning: High output level detected: " << String(event.value);
+            break;
+        case TelemetryEvent::Type::blockState:
+            text << "Block end - Active voices: " << String(event.count)
+                 << " Peak: " << String(event.value);
+            break;
+        case TelemetryEvent::Type::overrun:
+            text << "Warning: Block of " << String(event.count) << " samples missed its deadline, load: "
+                 << String(event.value, 2);
+            break;
+    }
+
+    return text;
+}
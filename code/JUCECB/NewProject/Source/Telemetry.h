@@ -0,0 +1,121 @@
+/*
+ ==============================================================================
+
+ Lock-free telemetry channel for the audio thread.
+
+ processBlock() pushes small binary event records into a preallocated
+ single-producer/single-consumer ring. A background thread drains the ring
+ and formats the events into the debug log, so no file IO or String
+ allocation ever happens inside the realtime callback.
+
+ ==============================================================================
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+// Severity of a telemetry event. Anything above the compile-time ceiling is
+// stripped out entirely; the runtime level filters further.
+enum class TelemetryLevel : int
+{
+    off = 0,
+    warning = 1,
+    info = 2,
+    debug = 3
+};
+
+#ifndef JUCECB_TELEMETRY_LEVEL
+ #if JUCE_DEBUG
+  #define JUCECB_TELEMETRY_LEVEL 3   // debug
+ #else
+  #define JUCECB_TELEMETRY_LEVEL 1   // warning
+ #endif
+#endif
+
+struct TelemetryEvent
+{
+    enum class Type : uint8_t
+    {
+        noteOn,           // note, count = active voices, value = velocity
+        noteOff,          // note
+        noteOffUnmatched, // note
+        voiceSteal,       // note = stolen note
+        voiceCleanup,     // count = voices removed
+        peakLevel,        // value = block peak
+        blockState,       // count = active voices, value = block peak
+        overrun           // count = block length, value = load
+    };
+
+    Type type = Type::blockState;
+    TelemetryLevel level = TelemetryLevel::debug;
+    int16_t note = -1;
+    int32_t count = 0;
+    float value = 0.0f;
+    juce::int64 sampleTime = 0; // Host sample counter when the event was raised
+};
+
+//==============================================================================
+class Telemetry : private juce::Thread
+{
+    public:
+    static constexpr int capacity = 1024; // events, must cover the drain interval
+    static constexpr int drainIntervalMs = 100;
+
+    Telemetry();
+    ~Telemetry() override;
+
+    void start();
+    void stop();
+
+    void setLevel(TelemetryLevel newLevel) noexcept { runtimeLevel.store(static_cast<int>(newLevel)); }
+    TelemetryLevel getLevel() const noexcept { return static_cast<TelemetryLevel>(runtimeLevel.load()); }
+
+    static constexpr bool isCompiledIn(TelemetryLevel level) noexcept
+    {
+        return static_cast<int>(level) <= JUCECB_TELEMETRY_LEVEL;
+    }
+
+    bool isEnabled(TelemetryLevel level) const noexcept
+    {
+        return isCompiledIn(level)
+            && static_cast<int>(level) <= runtimeLevel.load(std::memory_order_relaxed);
+    }
+
+    // Audio thread only. Never blocks or allocates; if the ring is full the
+    // event is dropped and counted instead.
+    void post(TelemetryLevel level, TelemetryEvent::Type type, juce::int64 sampleTime,
+              int note = -1, int count = 0, float value = 0.0f) noexcept
+    {
+        if (!isEnabled(level)) {
+            return;
+        }
+
+        TelemetryEvent event;
+        event.type = type;
+        event.level = level;
+        event.note = static_cast<int16_t>(note);
+        event.count = count;
+        event.value = value;
+        event.sampleTime = sampleTime;
+        push(event);
+    }
+
+    void push(const TelemetryEvent& event) noexcept;
+
+    uint32_t getNumDropped() const noexcept { return dropped.load(); }
+
+    private:
+    void run() override;
+    void drain();
+    static String format(const TelemetryEvent& event);
+
+    juce::AbstractFifo fifo { capacity };
+    std::array<TelemetryEvent, capacity> events;
+    std::atomic<int> runtimeLevel { JUCECB_TELEMETRY_LEVEL };
+    std::atomic<uint32_t> dropped { 0 };
+    uint32_t droppedReported = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Telemetry)
+};
@@ -0,0 +1,230 @@
+/*
+ ==============================================================================
+
+ Scoped trace markers, exported in the Chrome trace format.
+
+ ==============================================================================
+ */
+
+#include "Tracing.h"
+
+namespace
+{
+    struct Slot
+    {
+        std::atomic<bool> claimed { false };
+        std::atomic<juce::uint32> owner { 0 };       // Odd while a new thread is taking the slot over
+        std::atomic<juce::uint64> firstEvent { 0 };  // The current owner's first event
+        std::atomic<juce::uint64> written { 0 };
+        std::atomic<const char*> label { nullptr };
+        HeapBlock<Tracing::Event> events;
+        char threadName[64] {};
+    };
+
+    struct Buffers
+    {
+        std::array<Slot, Tracing::maxThreads> slots;
+        std::atomic<bool> ready { false };
+    };
+
+    Buffers& getBuffers()
+    {
+        static Buffers buffers;
+        return buffers;
+    }
+
+    // Takes the first free slot for the calling thread. The ring keeps
+    // counting from where the last owner stopped, and the dump starts at
+    // firstEvent, so old events are never shown under the new name.
+    int claimSlot() noexcept
+    {
+        auto& buffers = getBuffers();
+        for (int i = 0; i < Tracing::maxThreads; i++) {
+            auto& slot = buffers.slots[static_cast<size_t>(i)];
+            bool expected = false;
+            if (slot.claimed.load(std::memory_order_relaxed)
+                || !slot.claimed.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+                continue;
+            }
+
+            slot.owner.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            slot.label.store(nullptr, std::memory_order_relaxed);
+            slot.threadName[0] = 0;
+            if (auto* thread = Thread::getCurrentThread()) {
+                thread->getThreadName().copyToUTF8(slot.threadName, sizeof(slot.threadName));
+            }
+            slot.firstEvent.store(slot.written.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            slot.owner.fetch_add(1, std::memory_order_release);
+            return i;
+        }
+        return -1;
+    }
+
+    // The calling thread's slot, handed back when the thread exits
+    struct CurrentSlot
+    {
+        static constexpr int unclaimed = -1, noRoom = -2;
+
+        ~CurrentSlot()
+        {
+            if (index >= 0) {
+                getBuffers().slots[static_cast<size_t>(index)].claimed.store(false, std::memory_order_release);
+            }
+        }
+
+        int index = unclaimed;
+    };
+
+    // Claimed on the thread's first event. While all maxThreads slots are
+    // taken the thread isn't traced; it only tries again if retryIfFull.
+    Slot* getCurrentSlot(bool retryIfFull = false) noexcept
+    {
+        thread_local CurrentSlot current;
+
+        if (current.index < 0) {
+            if (current.index == CurrentSlot::noRoom && !retryIfFull) {
+                return nullptr;
+            }
+            if (!getBuffers().ready.load(std::memory_order_acquire)) {
+                return nullptr;
+            }
+
+            const int claimed = claimSlot();
+            current.index = claimed >= 0 ? claimed : CurrentSlot::noRoom;
+        }
+
+        return current.index >= 0 ? &getBuffers().slots[static_cast<size_t>(current.index)] : nullptr;
+    }
+
+    String escape(const String& text)
+    {
+        return text.replace("\\", "\\\\").replace("\"", "\\\"");
+    }
+}
+
+//==============================================================================
+void Tracing::prepare()
+{
+    auto& buffers = getBuffers();
+    if (buffers.ready.load()) {
+        return;
+    }
+
+    for (auto& slot : buffers.slots) {
+        slot.events.allocate(static_cast<size_t>(eventsPerThread), true);
+    }
+    buffers.ready.store(true, std::memory_order_release);
+}
+
+void Tracing::nameCurrentThread(const char* name) noexcept
+{
+    if (auto* slot = getCurrentSlot(true)) {
+        if (slot->label.load(std::memory_order_relaxed) != name) {
+            slot->label.store(name, std::memory_order_relaxed);
+        }
+    }
+}
+
+void Tracing::record(const char* category, const char* name, juce::int64 start,
+                     juce::int64 end, juce::int32 value) noexcept
+{
+    auto* slot = getCurrentSlot();
+    if (slot == nullptr) {
+        return;
+    }
+
+    const auto index = slot->written.load(std::memory_order_relaxed);
+    auto& event = slot->events[static_cast<size_t>(index & (eventsPerThread - 1))];
+    event.category = category;
+    event.name = name;
+    event.start = start;
+    event.duration = static_cast<juce::uint32>(jlimit(juce::int64(0), juce::int64(0xffffffff), end - start));
+    event.value = value;
+    slot->written.store(index + 1, std::memory_order_release);
+}
+
+bool Tracing::writeChromeTrace(const File& file)
+{
+    auto& buffers = getBuffers();
+    const int numSlots = buffers.ready.load(std::memory_order_acquire) ? maxThreads : 0;
+
+    // Copy each ring, then drop whatever its thread may have overwritten
+    // while it was being copied. A slot that changed hands meanwhile is
+    // left out altogether.
+    std::vector<std::vector<Event>> threads(static_cast<size_t>(numSlots));
+    std::vector<String> threadNames(static_cast<size_t>(numSlots));
+    juce::int64 earliest = std::numeric_limits<juce::int64>::max();
+
+    for (int t = 0; t < numSlots; t++) {
+        auto& slot = buffers.slots[static_cast<size_t>(t)];
+        const auto owner = slot.owner.load(std::memory_order_acquire);
+        if (owner == 0 || (owner & 1) != 0) {
+            continue;
+        }
+
+        const auto* label = slot.label.load(std::memory_order_relaxed);
+        String threadName = label != nullptr ? String(label)
+                          : slot.threadName[0] != 0 ? String(slot.threadName)
+                          : "Thread " + String(t);
+        const auto first = slot.firstEvent.load(std::memory_order_relaxed);
+        const auto end = slot.written.load(std::memory_order_acquire);
+        auto begin = jmax(first, end > static_cast<juce::uint64>(eventsPerThread) ? end - eventsPerThread : 0);
+        std::vector<Event> copied;
+        copied.reserve(static_cast<size_t>(end - begin));
+        for (auto i = begin; i < end; i++) {
+            copied.push_back(slot.events[static_cast<size_t>(i & (eventsPerThread - 1))]);
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.owner.load(std::memory_order_relaxed) != owner) {
+            continue;
+        }
+
+        // The writer may be part way through event after, which shares its
+        // element with after - eventsPerThread
+        const auto after = slot.written.load(std::memory_order_relaxed);
+        const auto firstIntact = after >= static_cast<juce::uint64>(eventsPerThread) ? after - eventsPerThread + 1 : 0;
+        if (firstIntact > begin) {
+            copied.erase(copied.begin(), copied.begin() + static_cast<std::ptrdiff_t>(jmin(firstIntact, end) - begin));
+        }
+
+        for (const auto& event : copied) {
+            earliest = jmin(earliest, event.start);
+        }
+        threads[static_cast<size_t>(t)] = std::move(copied);
+        threadNames[static_cast<size_t>(t)] = std::move(threadName);
+    }
+
+    const double microsecondsPerTick = 1.0e6 / static_cast<double>(Time::getHighResolutionTicksPerSecond());
+
+    MemoryOutputStream json;
+    json << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+         << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"JUCECB\"}}";
+
+    char line[512];
+    for (int t = 0; t < numSlots; t++) {
+        const auto& threadName = threadNames[static_cast<size_t>(t)];
+        if (threadName.isEmpty()) {
+            continue;
+        }
+        json << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << t
+             << ",\"args\":{\"name\":\"" << escape(threadName) << "\"}}";
+
+        for (const auto& event : threads[static_cast<size_t>(t)]) {
+            const double timestamp = static_cast<double>(event.start - earliest) * microsecondsPerTick;
+            const double duration = static_cast<double>(event.duration) * microsecondsPerTick;
+            int length = std::snprintf(line, sizeof(line),
+                                       ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+                                       event.name, event.category, t, timestamp, duration);
+            if (event.value >= 0 && length > 0 && length < static_cast<int>(sizeof(line))) {
+                length += std::snprintf(line + length, sizeof(line) - static_cast<size_t>(length),
+                                        ",\"args\":{\"value\":%d}", static_cast<int>(event.value));
+            }
+            json << line << "}";
+        }
+    }
+    json << "\n]}\n";
+
+    return file.replaceWithData(json.getData(), json.getDataSize());
+}
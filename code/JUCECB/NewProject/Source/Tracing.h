@@ -0,0 +1,109 @@
+/*
+ ==============================================================================
+
+ Scoped trace markers, exported in the Chrome trace format.
+
+ Build with JUCECB_TRACING=1 (e.g. make CPPFLAGS=-DJUCECB_TRACING=1) to
+ compile the JUCECB_TRACE_* markers in; otherwise they expand to nothing.
+ Each marker records a name, a start time and a duration into a ring
+ buffer owned by the calling thread. Recording is two clock reads and a
+ few stores, with no locks or allocation after a thread's first marker, so
+ the audio thread can be traced too. Every thread keeps its most recent
+ eventsPerThread events, so the trace can be dumped right after a glitch.
+ The audio thread only marks block-level stages, not single voices or MIDI
+ events, so that is a few seconds of its activity even at small block
+ sizes.
+
+ A thread claims a ring on its first marker and hands it back when it
+ exits, so threads that come and go don't use up the maxThreads rings.
+
+ writeChromeTrace() writes all threads on one timeline as JSON, which
+ chrome://tracing and ui.perfetto.dev open directly.
+
+ ==============================================================================
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#ifndef JUCECB_TRACING
+ #define JUCECB_TRACING 0
+#endif
+
+//==============================================================================
+class Tracing
+{
+    public:
+    static constexpr int maxThreads = 32;
+
+    // The audio thread records about four events per block plus one or two
+    // per MIDI event, so this holds around three seconds at 32 samples and
+    // 96 kHz, and ten at 64 samples and 48 kHz
+    static constexpr int eventsPerThread = 1 << 15; // Power of two
+
+    struct Event
+    {
+        const char* category;
+        const char* name;
+        juce::int64 start;  // High resolution ticks
+        juce::uint32 duration;
+        juce::int32 value;  // Shown as an argument unless negative
+    };
+
+    // Allocates the ring buffers; markers before this are dropped. Call once
+    // from a non-realtime thread.
+    static void prepare();
+
+    // Labels the calling thread in the trace. JUCE threads are named
+    // automatically. name must be a string literal. A thread that found
+    // every ring taken tries again here, so the audio thread, which calls
+    // this every block, picks one up as soon as another thread exits.
+    static void nameCurrentThread(const char* name) noexcept;
+
+    static void record(const char* category, const char* name, juce::int64 start,
+                       juce::int64 end, juce::int32 value) noexcept;
+
+    // Any thread. Events being overwritten while they are copied are left
+    // out. An exited thread's events stay until its ring is taken over.
+    static bool writeChromeTrace(const File& file);
+
+    static constexpr bool isCompiledIn() { return JUCECB_TRACING != 0; }
+
+    class Scope
+    {
+        public:
+        Scope(const char* categoryToUse, const char* nameToUse, juce::int64 valueToUse = -1) noexcept
+            : category(categoryToUse), name(nameToUse), value(valueToUse),
+              start(nameToUse != nullptr ? Time::getHighResolutionTicks() : 0) {}
+
+        ~Scope()
+        {
+            if (name != nullptr) {
+                record(category, name, start, Time::getHighResolutionTicks(), static_cast<juce::int32>(value));
+            }
+        }
+
+        private:
+        const char* category;
+        const char* name;
+        const juce::int64 value;
+        const juce::int64 start;
+
+        JUCE_DECLARE_NON_COPYABLE (Scope)
+    };
+};
+
+#if JUCECB_TRACING
+ #define JUCECB_TRACE_PREPARE()                            Tracing::prepare()
+ #define JUCECB_TRACE_THREAD_NAME(name)                    Tracing::nameCurrentThread (name)
+ #define JUCECB_TRACE_SCOPE(category, name)                const Tracing::Scope JUCE_JOIN_MACRO (traceScope, __LINE__) (category, name)
+ #define JUCECB_TRACE_SCOPE_VALUE(category, name, value)   const Tracing::Scope JUCE_JOIN_MACRO (traceScope, __LINE__) (category, name, value)
+ #define JUCECB_TRACE_SCOPE_IF(condition, category, name)  const Tracing::Scope JUCE_JOIN_MACRO (traceScope, __LINE__) (category, (condition) ? (name) : nullptr)
+#else
+ #define JUCECB_TRACE_PREPARE()
+ #define JUCECB_TRACE_THREAD_NAME(name)
+ #define JUCECB_TRACE_SCOPE(category, name)
+ #define JUCECB_TRACE_SCOPE_VALUE(category, name, value)
+ #define JUCECB_TRACE_SCOPE_IF(condition, category, name)
+#endif
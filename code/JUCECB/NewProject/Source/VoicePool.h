@@ -0,0 +1,318 @@
+/*
+ ==============================================================================
+
+ Fixed-capacity, allocation-free voice pool.
+
+ Per-voice state is stored structure-of-arrays. Live voices always occupy
+ slots [0, size()), so the render and envelope loops stream through
+ contiguous memory. Starting, stealing, releasing and removing voices only
+ move values between slots and never allocate.
+
+ Each voice runs an attack/sustain/release envelope clocked by output
+ samples, so its timing no longer depends on the playback rate. The attack
+ (smooth cubic) and release (quadratic decay) curves are polynomials, which
+ renderEnvelope() steps with forward differences: a handful of adds per
+ sample instead of a divide and a pow.
+
+ ==============================================================================
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#ifndef JUCECB_MAX_VOICES
+ #define JUCECB_MAX_VOICES 16
+#endif
+
+//==============================================================================
+struct VoicePool
+{
+    static constexpr int capacity = JUCECB_MAX_VOICES;
+    static constexpr int defaultPolyphony = 4;
+
+    enum EnvelopeStage : uint8_t
+    {
+        attack,
+        sustain,
+        release,
+        finished
+    };
+
+    // Called from prepareToPlay and whenever a new sample is loaded. Kills
+    // every voice.
+    void prepare(double newSampleRate)
+    {
+        sampleRate = newSampleRate > 0.0 ? newSampleRate : 44100.0;
+        reset();
+    }
+
+    void reset()
+    {
+        numActive = 0;
+        active.fill(0);
+        envelopeStage.fill(finished);
+    }
+
+    void setPolyphony(int newPolyphony) { polyphony = jlimit(1, capacity, newPolyphony); }
+    int getPolyphony() const { return polyphony; }
+
+    int size() const { return numActive; }
+    bool isEmpty() const { return numActive == 0; }
+    bool isFull() const { return numActive >= polyphony; }
+
+    // Starts a voice in a free slot. Returns the slot, or -1 if the pool is full.
+    int startVoice(int note, double rate, float vel)
+    {
+        if (isFull()) {
+            return -1;
+        }
+
+        const int slot = numActive++;
+        initialiseSlot(slot, note, rate, vel);
+        return slot;
+    }
+
+    // Restarts the longest-running voice with a new note. Returns the slot,
+    // and the note that was stolen through stolenNote.
+    int stealOldest(int note, double rate, float vel, int& stolenNote)
+    {
+        jassert(numActive > 0);
+
+        int oldest = 0;
+        for (int slot = 1; slot < numActive; slot++) {
+            if (startOrder[static_cast<size_t>(slot)] < startOrder[static_cast<size_t>(oldest)]) {
+                oldest = slot;
+            }
+        }
+
+        stolenNote = midiNote[static_cast<size_t>(oldest)];
+        initialiseSlot(oldest, note, rate, vel);
+        return oldest;
+    }
+
+    // Removes a voice by moving the last live voice into its slot.
+    void removeVoice(int slot)
+    {
+        jassert(isPositiveAndBelow(slot, numActive));
+        const int last = --numActive;
+        if (slot != last) {
+            moveSlot(last, slot);
+        }
+        active[static_cast<size_t>(last)] = 0;
+    }
+
+    // Compacts away voices that finished during the previous block.
+    // Returns the number of voices removed.
+    int removeInactive()
+    {
+        int removed = 0;
+        for (int slot = numActive; --slot >= 0;) {
+            if (!active[static_cast<size_t>(slot)]) {
+                removeVoice(slot);
+                removed++;
+            }
+        }
+        return removed;
+    }
+
+    // Kills every voice playing the given note. Returns the number killed.
+    int removeNote(int note)
+    {
+        int removed = 0;
+        for (int slot = numActive; --slot >= 0;) {
+            if (midiNote[static_cast<size_t>(slot)] == note) {
+                removeVoice(slot);
+                removed++;
+            }
+        }
+        return removed;
+    }
+
+    // Finds a held (not yet releasing) voice for the note, or -1.
+    int findHeldVoice(int note) const
+    {
+        for (int slot = 0; slot < numActive; slot++) {
+            if (midiNote[static_cast<size_t>(slot)] == note && !isReleasing(slot)) {
+                return slot;
+            }
+        }
+        return -1;
+    }
+
+    bool isReleasing(int slot) const
+    {
+        return envelopeStage[static_cast<size_t>(slot)] >= release;
+    }
+
+    // Starts the release from the current envelope level, however far the
+    // attack got.
+    void triggerRelease(int slot, float releaseSeconds)
+    {
+        const auto i = static_cast<size_t>(slot);
+        if (isReleasing(slot)) {
+            return;
+        }
+
+        const double level = envelopeValue[i];
+        const int length = segmentLength(releaseSeconds);
+
+        // level * (1 - n / length)^2 = level - 2a * length * n + a * n^2
+        const double a = level / (static_cast<double>(length) * length);
+        startSegment(i, release, length, level, -2.0 * a * length, a, 0.0);
+    }
+
+    void setPitchBend(double pitchBendFactor)
+    {
+        for (size_t i = 0; i < static_cast<size_t>(numActive); i++) {
+            playbackRate[i] = basePlaybackRate[i] * pitchBendFactor;
+        }
+    }
+
+    // Writes the next numSamples envelope gains for a voice. Returns how
+    // many were written; fewer than numSamples means the release finished
+    // and the voice is now inactive.
+    int renderEnvelope(int slot, float* gains, int numSamples)
+    {
+        const auto i = static_cast<size_t>(slot);
+        int done = 0;
+
+        while (done < numSamples) {
+            if (envelopeStage[i] == finished) {
+                active[i] = 0;
+                return done;
+            }
+
+            if (envelopeStage[i] == sustain) {
+                std::fill(gains + done, gains + numSamples, 1.0f);
+                return numSamples;
+            }
+
+            const int n = jmin(numSamples - done, envelopeRemaining[i]);
+            double value = envelopeValue[i];
+            double delta = envelopeDelta[i];
+            double delta2 = envelopeDelta2[i];
+            const double delta3 = envelopeDelta3[i];
+
+            for (int k = 0; k < n; k++) {
+                gains[done + k] = static_cast<float>(jlimit(0.0, 1.0, value));
+                value += delta;
+                delta += delta2;
+                delta2 += delta3;
+            }
+
+            envelopeValue[i] = value;
+            envelopeDelta[i] = delta;
+            envelopeDelta2[i] = delta2;
+            envelopeRemaining[i] -= n;
+            done += n;
+
+            if (envelopeRemaining[i] == 0) {
+                if (envelopeStage[i] == attack) {
+                    holdSegment(i, sustain, 1.0);
+                } else {
+                    holdSegment(i, finished, 0.0);
+                }
+            }
+        }
+
+        return done;
+    }
+
+    //==============================================================================
+    // Hot per-voice state, touched every sample
+    alignas(64) std::array<double, capacity> samplePosition {};
+    alignas(64) std::array<double, capacity> playbackRate {};
+    alignas(64) std::array<float, capacity> previousSample {}; // Smoother state
+    alignas(64) std::array<float, capacity> velocity {};
+    alignas(64) std::array<uint8_t, capacity> active {};
+
+    // Envelope state: the current segment is a polynomial in the sample
+    // count, stepped by forward differences
+    alignas(64) std::array<double, capacity> envelopeValue {};
+    alignas(64) std::array<double, capacity> envelopeDelta {};
+    alignas(64) std::array<double, capacity> envelopeDelta2 {};
+    alignas(64) std::array<double, capacity> envelopeDelta3 {};
+    alignas(64) std::array<int, capacity> envelopeRemaining {}; // Samples left in the segment
+    alignas(64) std::array<uint8_t, capacity> envelopeStage {};
+
+    // Cold per-voice state, only touched on note events
+    std::array<int, capacity> midiNote {};
+    std::array<double, capacity> basePlaybackRate {};
+    std::array<uint32_t, capacity> startOrder {};
+
+    // Shared envelope settings
+    float attackTime = 0.01f;     // Attack time in seconds
+
+    private:
+    void initialiseSlot(int slot, int note, double rate, float vel)
+    {
+        const auto i = static_cast<size_t>(slot);
+        samplePosition[i] = 0.0;
+        playbackRate[i] = rate;
+        previousSample[i] = 0.0f;
+        velocity[i] = vel;
+        active[i] = 1;
+        midiNote[i] = note;
+        basePlaybackRate[i] = rate;
+        startOrder[i] = nextStartOrder++;
+
+        // t^2 * (3 - 2t), t = n / length
+        const int length = segmentLength(attackTime);
+        const double scale = 1.0 / length;
+        startSegment(i, attack, length, 0.0, 0.0, 3.0 * scale * scale, -2.0 * scale * scale * scale);
+    }
+
+    int segmentLength(float seconds) const
+    {
+        return jmax(1, roundToInt(seconds * sampleRate));
+    }
+
+    // Sets up forward differences for the curve c0 + c1 n + c2 n^2 + c3 n^3
+    // that runs for length samples. They come straight from the
+    // coefficients: differencing sampled points leaves a rounding residue in
+    // the third difference that the stepping grows with n^3.
+    void startSegment(size_t i, EnvelopeStage stage, int length,
+                      double c0, double c1, double c2, double c3)
+    {
+        envelopeStage[i] = stage;
+        envelopeRemaining[i] = length;
+        envelopeValue[i] = c0;
+        envelopeDelta[i] = c1 + c2 + c3;
+        envelopeDelta2[i] = 2.0 * c2 + 6.0 * c3;
+        envelopeDelta3[i] = 6.0 * c3;
+    }
+
+    void holdSegment(size_t i, EnvelopeStage stage, double value)
+    {
+        envelopeStage[i] = stage;
+        envelopeRemaining[i] = 0;
+        envelopeValue[i] = value;
+        envelopeDelta[i] = envelopeDelta2[i] = envelopeDelta3[i] = 0.0;
+    }
+
+    void moveSlot(int from, int to)
+    {
+        const auto f = static_cast<size_t>(from);
+        const auto t = static_cast<size_t>(to);
+        samplePosition[t] = samplePosition[f];
+        playbackRate[t] = playbackRate[f];
+        previousSample[t] = previousSample[f];
+        velocity[t] = velocity[f];
+        active[t] = active[f];
+        envelopeValue[t] = envelopeValue[f];
+        envelopeDelta[t] = envelopeDelta[f];
+        envelopeDelta2[t] = envelopeDelta2[f];
+        envelopeDelta3[t] = envelopeDelta3[f];
+        envelopeRemaining[t] = envelopeRemaining[f];
+        envelopeStage[t] = envelopeStage[f];
+        midiNote[t] = midiNote[f];
+        basePlaybackRate[t] = basePlaybackRate[f];
+        startOrder[t] = startOrder[f];
+    }
+
+    double sampleRate = 44100.0;
+    int numActive = 0;
+    int polyphony = defaultPolyphony;
+    uint32_t nextStartOrder = 0;
+};
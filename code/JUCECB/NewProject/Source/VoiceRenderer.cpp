@@ -0,0 +1,317 @@
+/*
+ ==============================================================================
+
+ Vectorised block renderer for the per-voice interpolation loop.
+
+ ==============================================================================
+ */
+
+#include "VoiceRenderer.h"
+
+#if JUCE_INTEL
+ #include <immintrin.h>
+#endif
+
+#if JUCECB_HAS_NEON
+ #include <arm_neon.h>
+#endif
+
+namespace
+{
+    using Samples = VoiceRenderer::Samples;
+
+    template <bool isInt16>
+    inline float readSample(const Samples& source, int index)
+    {
+        if constexpr (isInt16) {
+            return jlimit(-source.limit, source.limit, source.int16s[index] * source.scale);
+        } else {
+            return source.floats[index];
+        }
+    }
+
+    // Both int16 taps of a lane in one 32-bit load, first tap in the low half
+    inline int32_t loadTapPair(const int16_t* data, int index)
+    {
+        int32_t pair;
+        std::memcpy(&pair, data + index, sizeof(pair));
+        return pair;
+    }
+
+    //==============================================================================
+    template <bool dryIsInt16, bool wetIsInt16>
+    void renderScalar(Samples dry, Samples wet,
+                      double basePosition, double rate, int firstIndex, int numSamples,
+                      float dryMix, float wetMix, float* dest)
+    {
+        for (int i = 0; i < numSamples; i++) {
+            const double readPosition = basePosition + ((firstIndex + i) * rate);
+            const int pos1 = static_cast<int>(readPosition);
+            const int pos2 = pos1 + 1;
+            const float fraction = static_cast<float>(readPosition - pos1);
+
+            const float dry1 = readSample<dryIsInt16>(dry, pos1);
+            const float wet1 = readSample<wetIsInt16>(wet, pos1);
+            const float drySample = dry1 + (readSample<dryIsInt16>(dry, pos2) - dry1) * fraction;
+            const float wetSample = wet1 + (readSample<wetIsInt16>(wet, pos2) - wet1) * fraction;
+            dest[i] = drySample * dryMix + wetSample * wetMix;
+        }
+    }
+
+#if JUCE_INTEL
+    //==============================================================================
+    // Loads the two interpolation taps for four read positions
+    template <bool isInt16>
+    inline void loadTapsSSE2(const Samples& source, const int32_t* idx, __m128& tap0, __m128& tap1)
+    {
+        if constexpr (isInt16) {
+            const __m128i pairs = _mm_setr_epi32(loadTapPair(source.int16s, idx[0]), loadTapPair(source.int16s, idx[1]),
+                                                 loadTapPair(source.int16s, idx[2]), loadTapPair(source.int16s, idx[3]));
+            const __m128 scale = _mm_set1_ps(source.scale);
+            const __m128 upper = _mm_set1_ps(source.limit);
+            const __m128 lower = _mm_set1_ps(-source.limit);
+            const __m128 value0 = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(pairs, 16), 16)), scale);
+            const __m128 value1 = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(pairs, 16)), scale);
+            tap0 = _mm_min_ps(_mm_max_ps(value0, lower), upper);
+            tap1 = _mm_min_ps(_mm_max_ps(value1, lower), upper);
+        } else {
+            const float* data = source.floats;
+            tap0 = _mm_setr_ps(data[idx[0]], data[idx[1]], data[idx[2]], data[idx[3]]);
+            tap1 = _mm_setr_ps(data[idx[0] + 1], data[idx[1] + 1], data[idx[2] + 1], data[idx[3] + 1]);
+        }
+    }
+
+    template <bool dryIsInt16, bool wetIsInt16>
+    void renderSSE2(Samples dry, Samples wet,
+                    double basePosition, double rate, int firstIndex, int numSamples,
+                    float dryMix, float wetMix, float* dest)
+    {
+        const __m128d base = _mm_set1_pd(basePosition);
+        const __m128d step = _mm_set1_pd(rate);
+        const __m128 dryGain = _mm_set1_ps(dryMix);
+        const __m128 wetGain = _mm_set1_ps(wetMix);
+        alignas(16) int32_t idx[4];
+
+        int i = 0;
+        for (; i + 4 <= numSamples; i += 4) {
+            const double n = firstIndex + i;
+            const __m128d p0 = _mm_add_pd(base, _mm_mul_pd(_mm_set_pd(n + 1.0, n), step));
+            const __m128d p1 = _mm_add_pd(base, _mm_mul_pd(_mm_set_pd(n + 3.0, n + 2.0), step));
+            const __m128i i0 = _mm_cvttpd_epi32(p0);
+            const __m128i i1 = _mm_cvttpd_epi32(p1);
+            const __m128 fraction = _mm_movelh_ps(_mm_cvtpd_ps(_mm_sub_pd(p0, _mm_cvtepi32_pd(i0))),
+                                                  _mm_cvtpd_ps(_mm_sub_pd(p1, _mm_cvtepi32_pd(i1))));
+            _mm_store_si128(reinterpret_cast<__m128i*>(idx), _mm_unpacklo_epi64(i0, i1));
+
+            __m128 dry0, dry1, wet0, wet1;
+            loadTapsSSE2<dryIsInt16>(dry, idx, dry0, dry1);
+            loadTapsSSE2<wetIsInt16>(wet, idx, wet0, wet1);
+
+            const __m128 drySample = _mm_add_ps(dry0, _mm_mul_ps(_mm_sub_ps(dry1, dry0), fraction));
+            const __m128 wetSample = _mm_add_ps(wet0, _mm_mul_ps(_mm_sub_ps(wet1, wet0), fraction));
+            _mm_storeu_ps(dest + i, _mm_add_ps(_mm_mul_ps(drySample, dryGain),
+                                               _mm_mul_ps(wetSample, wetGain)));
+        }
+
+        renderScalar<dryIsInt16, wetIsInt16>(dry, wet, basePosition, rate, firstIndex + i, numSamples - i,
+                                             dryMix, wetMix, dest + i);
+    }
+
+    //==============================================================================
+    // Loads the two interpolation taps for eight read positions. An int16
+    // source needs one gather for both taps instead of two.
+    template <bool isInt16>
+    JUCECB_TARGET_AVX2
+    inline void loadTapsAVX2(const Samples& source, __m256i index, __m256& tap0, __m256& tap1)
+    {
+        if constexpr (isInt16) {
+            const __m256i pairs = _mm256_i32gather_epi32(reinterpret_cast<const int*>(source.int16s), index, 2);
+            const __m256 scale = _mm256_set1_ps(source.scale);
+            const __m256 upper = _mm256_set1_ps(source.limit);
+            const __m256 lower = _mm256_set1_ps(-source.limit);
+            const __m256 value0 = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srai_epi32(_mm256_slli_epi32(pairs, 16), 16)), scale);
+            const __m256 value1 = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srai_epi32(pairs, 16)), scale);
+            tap0 = _mm256_min_ps(_mm256_max_ps(value0, lower), upper);
+            tap1 = _mm256_min_ps(_mm256_max_ps(value1, lower), upper);
+        } else {
+            tap0 = _mm256_i32gather_ps(source.floats, index, 4);
+            tap1 = _mm256_i32gather_ps(source.floats, _mm256_add_epi32(index, _mm256_set1_epi32(1)), 4);
+        }
+    }
+
+    template <bool dryIsInt16, bool wetIsInt16>
+    JUCECB_TARGET_AVX2
+    void renderAVX2(Samples dry, Samples wet,
+                    double basePosition, double rate, int firstIndex, int numSamples,
+                    float dryMix, float wetMix, float* dest)
+    {
+        const __m256d base = _mm256_set1_pd(basePosition);
+        const __m256d step = _mm256_set1_pd(rate);
+        const __m256d lane = _mm256_setr_pd(0.0, 1.0, 2.0, 3.0);
+        const __m256 dryGain = _mm256_set1_ps(dryMix);
+        const __m256 wetGain = _mm256_set1_ps(wetMix);
+
+        int i = 0;
+        for (; i + 8 <= numSamples; i += 8) {
+            const __m256d n = _mm256_set1_pd(static_cast<double>(firstIndex + i));
+            const __m256d p0 = _mm256_add_pd(base, _mm256_mul_pd(_mm256_add_pd(n, lane), step));
+            const __m256d p1 = _mm256_add_pd(base, _mm256_mul_pd(_mm256_add_pd(n, _mm256_add_pd(lane, _mm256_set1_pd(4.0))), step));
+            const __m128i i0 = _mm256_cvttpd_epi32(p0);
+            const __m128i i1 = _mm256_cvttpd_epi32(p1);
+            const __m128 f0 = _mm256_cvtpd_ps(_mm256_sub_pd(p0, _mm256_cvtepi32_pd(i0)));
+            const __m128 f1 = _mm256_cvtpd_ps(_mm256_sub_pd(p1, _mm256_cvtepi32_pd(i1)));
+
+            const __m256i index = _mm256_setr_m128i(i0, i1);
+            const __m256 fraction = _mm256_setr_m128(f0, f1);
+
+            __m256 dry0, dry1, wet0, wet1;
+            loadTapsAVX2<dryIsInt16>(dry, index, dry0, dry1);
+            loadTapsAVX2<wetIsInt16>(wet, index, wet0, wet1);
+
+            const __m256 drySample = _mm256_add_ps(dry0, _mm256_mul_ps(_mm256_sub_ps(dry1, dry0), fraction));
+            const __m256 wetSample = _mm256_add_ps(wet0, _mm256_mul_ps(_mm256_sub_ps(wet1, wet0), fraction));
+            _mm256_storeu_ps(dest + i, _mm256_add_ps(_mm256_mul_ps(drySample, dryGain),
+                                                     _mm256_mul_ps(wetSample, wetGain)));
+        }
+
+        renderSSE2<dryIsInt16, wetIsInt16>(dry, wet, basePosition, rate, firstIndex + i, numSamples - i,
+                                           dryMix, wetMix, dest + i);
+    }
+#endif
+
+#if JUCECB_HAS_NEON
+    //==============================================================================
+    template <bool dryIsInt16, bool wetIsInt16>
+    void renderNEON(Samples dry, Samples wet,
+                    double basePosition, double rate, int firstIndex, int numSamples,
+                    float dryMix, float wetMix, float* dest)
+    {
+        const float64x2_t base = vdupq_n_f64(basePosition);
+        const float64x2_t step = vdupq_n_f64(rate);
+        alignas(16) int64_t idx[4];
+
+        int i = 0;
+        for (; i + 4 <= numSamples; i += 4) {
+            const double n = firstIndex + i;
+            const double lanes0[2] = { n, n + 1.0 };
+            const double lanes1[2] = { n + 2.0, n + 3.0 };
+            const float64x2_t p0 = vaddq_f64(base, vmulq_f64(vld1q_f64(lanes0), step));
+            const float64x2_t p1 = vaddq_f64(base, vmulq_f64(vld1q_f64(lanes1), step));
+            const int64x2_t i0 = vcvtq_s64_f64(p0);
+            const int64x2_t i1 = vcvtq_s64_f64(p1);
+            const float32x4_t fraction = vcombine_f32(vcvt_f32_f64(vsubq_f64(p0, vcvtq_f64_s64(i0))),
+                                                      vcvt_f32_f64(vsubq_f64(p1, vcvtq_f64_s64(i1))));
+            vst1q_s64(idx, i0);
+            vst1q_s64(idx + 2, i1);
+
+            float dry0Lanes[4], dry1Lanes[4], wet0Lanes[4], wet1Lanes[4];
+            for (int lane = 0; lane < 4; lane++) {
+                const int index = static_cast<int>(idx[lane]);
+                dry0Lanes[lane] = readSample<dryIsInt16>(dry, index);
+                dry1Lanes[lane] = readSample<dryIsInt16>(dry, index + 1);
+                wet0Lanes[lane] = readSample<wetIsInt16>(wet, index);
+                wet1Lanes[lane] = readSample<wetIsInt16>(wet, index + 1);
+            }
+            const float32x4_t dry0 = vld1q_f32(dry0Lanes);
+            const float32x4_t dry1 = vld1q_f32(dry1Lanes);
+            const float32x4_t wet0 = vld1q_f32(wet0Lanes);
+            const float32x4_t wet1 = vld1q_f32(wet1Lanes);
+
+            // Separate multiply and add (not vmlaq/vfmaq) to keep scalar rounding
+            const float32x4_t drySample = vaddq_f32(dry0, vmulq_f32(vsubq_f32(dry1, dry0), fraction));
+            const float32x4_t wetSample = vaddq_f32(wet0, vmulq_f32(vsubq_f32(wet1, wet0), fraction));
+            vst1q_f32(dest + i, vaddq_f32(vmulq_n_f32(drySample, dryMix),
+                                          vmulq_n_f32(wetSample, wetMix)));
+        }
+
+        renderScalar<dryIsInt16, wetIsInt16>(dry, wet, basePosition, rate, firstIndex + i, numSamples - i,
+                                             dryMix, wetMix, dest + i);
+    }
+#endif
+
+    //==============================================================================
+    const VoiceRenderer::KernelTable scalarKernels {{ { renderScalar<false, false>, renderScalar<false, true> },
+                                                      { renderScalar<true, false>, renderScalar<true, true> } }};
+#if JUCE_INTEL
+    const VoiceRenderer::KernelTable sse2Kernels {{ { renderSSE2<false, false>, renderSSE2<false, true> },
+                                                    { renderSSE2<true, false>, renderSSE2<true, true> } }};
+    const VoiceRenderer::KernelTable avx2Kernels {{ { renderAVX2<false, false>, renderAVX2<false, true> },
+                                                    { renderAVX2<true, false>, renderAVX2<true, true> } }};
+#endif
+#if JUCECB_HAS_NEON
+    const VoiceRenderer::KernelTable neonKernels {{ { renderNEON<false, false>, renderNEON<false, true> },
+                                                    { renderNEON<true, false>, renderNEON<true, true> } }};
+#endif
+
+    //==============================================================================
+    SimdDispatch::Dispatcher<VoiceRenderer::KernelTable>& getDispatcher()
+    {
+        static SimdDispatch::Dispatcher<VoiceRenderer::KernelTable> dispatcher { [] {
+            SimdDispatch::Tables<VoiceRenderer::KernelTable> tables;
+            tables.scalar = &scalarKernels;
+           #if JUCE_INTEL
+            tables.sse2 = &sse2Kernels;
+            tables.avx2 = &avx2Kernels;
+           #endif
+           #if JUCECB_HAS_NEON
+            tables.neon = &neonKernels;
+           #endif
+            return tables;
+        }() };
+        return dispatcher;
+    }
+}
+
+//==============================================================================
+const VoiceRenderer::KernelTable& VoiceRenderer::activeKernels()
+{
+    return getDispatcher().get();
+}
+
+void VoiceRenderer::bakeLoopTail(const float* source, int numSamples, int crossfadeLength, float* tail)
+{
+    const int tailStart = numSamples - crossfadeLength;
+
+    for (int i = 0; i < crossfadeLength; i++) {
+        // Raised-cosine crossfade from the end of the sample into its start
+        const float crossfadeGain = 0.5f * (1.0f - std::cos(MathConstants<float>::pi * i / crossfadeLength));
+        tail[i] = source[tailStart + i] * (1.0f - crossfadeGain) + source[i] * crossfadeGain;
+    }
+
+    for (int i = 0; i < guardSamples; i++) {
+        const int sourceIndex = crossfadeLength + i;
+        tail[crossfadeLength + i] = sourceIndex < numSamples ? source[sourceIndex] : 0.0f;
+    }
+}
+
+int VoiceRenderer::countSamplesBelow(double basePosition, double rate, int firstIndex,
+                                     int maxSamples, double limit)
+{
+    // Estimate analytically, then correct with the exact per-sample expression
+    // so rounding can never let a position at or above the limit through.
+    const double estimate = std::ceil((limit - basePosition) / rate) - firstIndex;
+    int count = static_cast<int>(jlimit(0.0, static_cast<double>(maxSamples), estimate));
+
+    while (count > 0 && basePosition + ((firstIndex + count - 1) * rate) >= limit) {
+        count--;
+    }
+    while (count < maxSamples && basePosition + ((firstIndex + count) * rate) < limit) {
+        count++;
+    }
+    return count;
+}
+
+bool VoiceRenderer::setImplementation(Implementation implementation)
+{
+    return getDispatcher().set(implementation);
+}
+
+VoiceRenderer::Implementation VoiceRenderer::getImplementation()
+{
+    return getDispatcher().getImplementation();
+}
+
+const char* VoiceRenderer::getImplementationName()
+{
+    return SimdDispatch::getName(getImplementation());
+}
@@ -0,0 +1,101 @@
+/*
+ ==============================================================================
+
+ Vectorised block renderer for the per-voice interpolation loop.
+
+ The kernels produce a run of linearly interpolated, wet/dry mixed samples
+ for one voice. There are SSE2, AVX2 and NEON versions plus a scalar
+ fallback. The best one the CPU supports is picked at runtime. Read
+ positions are computed in double precision exactly like the scalar loop,
+ so every kernel matches the scalar output to within float rounding.
+
+ Either source can also be int16 with a scale factor, which halves its
+ memory and the bandwidth the loop needs. The kernels convert the taps as
+ they read them; a single 32-bit load fetches both taps of a lane.
+
+ ==============================================================================
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "SimdDispatch.h"
+
+//==============================================================================
+struct VoiceRenderer
+{
+    // Samples rendered per pass; small enough to keep the scratch block in L1
+    static constexpr int chunkSize = 256;
+
+    // Extra samples after every source run, so the second interpolation tap
+    // never needs a modulo
+    static constexpr int guardSamples = 4;
+
+    // A run of source samples: floats, or int16 values that read as
+    // clamp(value * scale) to +-limit
+    struct Samples
+    {
+        Samples() = default;
+        Samples(const float* data) : floats(data) {}
+        Samples(const int16_t* data, float scaleToUse, float limitToUse)
+        : int16s(data), scale(scaleToUse), limit(limitToUse) {}
+
+        bool isInt16() const { return int16s != nullptr; }
+
+        float operator[] (int index) const
+        {
+            return isInt16() ? jlimit(-limit, limit, int16s[index] * scale) : floats[index];
+        }
+
+        const float* floats = nullptr;
+        const int16_t* int16s = nullptr;
+        float scale = 1.0f;
+        float limit = 1.0f;
+    };
+
+    using Implementation = SimdDispatch::Implementation;
+
+    // dest[i] = lerp(dry) * dryMix + lerp(wet) * wetMix at the read position
+    // basePosition + (firstIndex + i) * rate, for i in [0, numSamples).
+    // Every read position must satisfy 0 <= position < sourceLength - 1, so
+    // both interpolation taps are in range without wrapping.
+    using Kernel = void (*)(Samples dry, Samples wet,
+                            double basePosition, double rate, int firstIndex, int numSamples,
+                            float dryMix, float wetMix, float* dest);
+
+    // One kernel per storage combination, indexed [dry is int16][wet is int16]
+    struct KernelTable
+    {
+        Kernel kernels[2][2];
+    };
+
+    static void renderInterpolated(Samples dry, Samples wet,
+                                   double basePosition, double rate, int firstIndex, int numSamples,
+                                   float dryMix, float wetMix, float* dest)
+    {
+        const auto& table = activeKernels();
+        table.kernels[dry.isInt16()][wet.isInt16()](dry, wet, basePosition, rate, firstIndex,
+                                                    numSamples, dryMix, wetMix, dest);
+    }
+
+    // Bakes the crossfaded loop tail for a looped source. tail must hold
+    // crossfadeLength + guardSamples floats. The tail replaces the last
+    // crossfadeLength samples of the source while looping: it fades from the
+    // source end into its first samples, and its guard samples continue at
+    // the loop start (crossfadeLength), where playback wraps to.
+    static void bakeLoopTail(const float* source, int numSamples, int crossfadeLength, float* tail);
+
+    // Counts how many samples starting at firstIndex (at most maxSamples)
+    // have a read position strictly below limit. Positions must be increasing.
+    static int countSamplesBelow(double basePosition, double rate, int firstIndex,
+                                 int maxSamples, double limit);
+
+    // Forces a specific kernel, e.g. for benchmarks. Returns false and keeps
+    // the current kernel if the CPU or build doesn't support the request.
+    static bool setImplementation(Implementation implementation);
+    static Implementation getImplementation();
+    static const char* getImplementationName();
+
+    private:
+    static const KernelTable& activeKernels();
+};
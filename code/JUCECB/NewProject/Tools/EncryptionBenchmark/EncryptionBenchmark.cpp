@@ -0,0 +1,403 @@
+/*
+ ==============================================================================
+
+ Encryption pipeline throughput benchmark.
+
+ Times JUCECB::encryptAudioECB end to end on the encryption pool, then
+ the same pipeline one stage at a time on a single lane:
+
+   measure       level measurement that the normalize scale comes from
+   key           the key schedule, once per pass
+   quantize      normalize, clamp, quantize and int16 conversion (one
+                 fused kernel)
+   cipher        the codebook plus AES, as encryptAudioECB uses it
+   aes           AES alone on the same blocks, for comparison
+   renormalize   int16 back to float while measuring the encrypted level
+   clip          the output gain and hard clip
+
+ The signal is a file from "Sound samples" repeated to length, or white
+ noise, which defeats the codebook. Every iteration alternates between
+ the key and a one-character variant, so the key schedule and the
+ codebook always start cold, like after a key change.
+
+ By default the length, quantize level, key, signal and kernel set are
+ each varied on their own from a 60 s baseline; --full runs every
+ combination. Each run records how far the resident size grew above
+ where it started, sampled between iterations, so runs after a long one
+ still show their own footprint; the process peak is reported once.
+
+ Usage:
+   EncryptionBenchmark [--sample=<file>] [--max-seconds=<s>] [--min-time=<s>]
+                       [--full] [--output=<file.json>]
+
+ ==============================================================================
+ */
+
+#include "../ToolHelpers.h"
+
+namespace
+{
+    enum class Signal
+    {
+        sample,
+        noise
+    };
+
+    struct Settings
+    {
+        double lengthSeconds = 60.0;
+        int numLevels = 16;
+        String key = "DefaultKey123";
+        Signal signal = Signal::sample;
+        EncryptionKernels::Implementation kernels = EncryptionKernels::Implementation::automatic;
+    };
+
+    const char* getSignalName(Signal signal)
+    {
+        return signal == Signal::noise ? "noise" : "sample";
+    }
+
+    // Same length, different first character, so setKey() always re-keys
+    String getKeyVariant(const String& key)
+    {
+        if (key.isEmpty()) {
+            return "x";
+        }
+        return String::charToString(key[0] == 'x' ? 'y' : 'x') + key.substring(1);
+    }
+
+    struct Source
+    {
+        AudioBuffer<float> sample; // Mono
+        double sampleRate = 44100.0;
+    };
+
+    bool readSample(const File& file, Source& source)
+    {
+        AudioFormatManager formatManager;
+        formatManager.registerBasicFormats();
+        std::unique_ptr<AudioFormatReader> reader(formatManager.createReaderFor(file));
+        if (reader == nullptr || reader->lengthInSamples <= 0) {
+            return false;
+        }
+
+        const int numSamples = static_cast<int>(jmin(reader->lengthInSamples, juce::int64(1 << 24)));
+        const int numChannels = static_cast<int>(reader->numChannels);
+        AudioBuffer<float> decoded(numChannels, numSamples);
+        reader->read(&decoded, 0, numSamples, 0, true, true);
+
+        // Mix down like the plugin does
+        source.sample.setSize(1, numSamples);
+        source.sample.clear();
+        for (int channel = 0; channel < numChannels; channel++) {
+            source.sample.addFrom(0, 0, decoded, channel, 0, numSamples, 1.0f / numChannels);
+        }
+        source.sampleRate = reader->sampleRate;
+        return true;
+    }
+
+    void fillSignal(AudioBuffer<float>& buffer, const Source& source, Signal signal)
+    {
+        float* data = buffer.getWritePointer(0);
+        const int numSamples = buffer.getNumSamples();
+
+        if (signal == Signal::noise) {
+            Random random(0x4a554345); // Fixed, so every build sees the same blocks
+            for (int i = 0; i < numSamples; i++) {
+                data[i] = random.nextFloat() * 2.0f - 1.0f;
+            }
+            return;
+        }
+
+        const float* sample = source.sample.getReadPointer(0);
+        const int sampleLength = source.sample.getNumSamples();
+        for (int start = 0; start < numSamples; start += sampleLength) {
+            std::copy(sample, sample + jmin(sampleLength, numSamples - start), data + start);
+        }
+    }
+
+    struct StageTimes
+    {
+        double measure = 0.0, key = 0.0, quantize = 0.0, cipher = 0.0, aes = 0.0, renormalize = 0.0, clip = 0.0;
+        juce::int64 numBlocks = 0, numBlocksEncrypted = 0;
+    };
+
+    // One pass of the pipeline on a single lane, chunk by chunk like
+    // encryptAudioECB, timing each stage separately
+    void timeStages(AudioBuffer<float>& buffer, const String& key, int numLevels,
+                    EncryptionPool::Lane& lane, HeapBlock<int16_t>& aesCopy, StageTimes& times)
+    {
+        constexpr int chunkSamples = EncryptionPool::chunkSamples;
+        float* data = buffer.getWritePointer(0);
+        const int numSamples = buffer.getNumSamples();
+        auto* bytes = reinterpret_cast<uint8_t*>(lane.staging.getData());
+        auto* aesBytes = reinterpret_cast<uint8_t*>(aesCopy.getData());
+
+        auto start = Time::getHighResolutionTicks();
+        auto lap = [&start] (double& stage) {
+            const auto now = Time::getHighResolutionTicks();
+            stage += ToolHelpers::ticksToNanoseconds(now - start);
+            start = now;
+        };
+        auto skip = [&start] { start = Time::getHighResolutionTicks(); };
+
+        double sumOfSquares = 0.0;
+        float peak = 0.0f;
+        EncryptionKernels::measure(data, numSamples, sumOfSquares, peak);
+        lap(times.measure);
+
+        const float rms = static_cast<float>(std::sqrt(sumOfSquares / numSamples));
+        const float normalizeScale = peak > 0.0f ? 0.95f / peak : 1.0f;
+        const float quantizationStep = 1.9f / numLevels;
+        juce::int64 encryptedSumOfSquares = 0;
+
+        lane.cipher.setKey(key);
+        lap(times.key);
+
+        for (int offset = 0; offset < numSamples; offset += chunkSamples) {
+            const int length = jmin(chunkSamples, numSamples - offset);
+            const int dataBytes = length * static_cast<int>(sizeof(int16_t));
+            const int numBytes = (dataBytes + EcbCipher::blockSize - 1) / EcbCipher::blockSize * EcbCipher::blockSize;
+
+            EncryptionKernels::quantizeToInt16(data + offset, length, normalizeScale, quantizationStep,
+                                               lane.staging.getData());
+            std::fill(bytes + dataBytes, bytes + numBytes, static_cast<uint8_t>(numBytes - dataBytes));
+            lap(times.quantize);
+
+            std::copy(bytes, bytes + numBytes, aesBytes);
+            skip();
+
+            const int encrypted = lane.codebook.encryptInPlace(lane.cipher, bytes, numBytes);
+            lap(times.cipher);
+            times.numBlocks += numBytes / EcbCipher::blockSize;
+            times.numBlocksEncrypted += jmax(0, encrypted);
+
+            lane.cipher.encryptInPlace(aesBytes, numBytes);
+            lap(times.aes);
+
+            encryptedSumOfSquares += EncryptionKernels::convertFromInt16(lane.staging.getData(), length, data + offset);
+            lap(times.renormalize);
+        }
+
+        const float gain = JUCECB::getEncryptedGain(rms, encryptedSumOfSquares, numSamples);
+        EncryptionKernels::applyGainAndClip(data, numSamples, gain);
+        lap(times.clip);
+    }
+
+    var runBenchmark(JUCECB& processor, const Source& source, const Settings& settings, double minSeconds)
+    {
+        if (!EncryptionKernels::setImplementation(settings.kernels)) {
+            return {};
+        }
+
+        const auto residentBefore = ToolHelpers::getResidentBytes();
+        auto residentPeak = residentBefore;
+        auto sampleResident = [&residentPeak] { residentPeak = jmax(residentPeak, ToolHelpers::getResidentBytes()); };
+
+        const int numSamples = jmax(1, roundToInt(settings.lengthSeconds * source.sampleRate));
+        const double megabytes = numSamples * sizeof(float) / 1.0e6;
+        const String keys[] = { settings.key, getKeyVariant(settings.key) };
+        const EncryptionWorker::AbortCheck neverAbort = [] { return false; };
+
+        AudioBuffer<float> buffer(1, numSamples);
+        double levelSumOfSquares = 0.0;
+        float peak = 0.0f;
+        fillSignal(buffer, source, settings.signal);
+        EncryptionKernels::measure(buffer.getReadPointer(0), numSamples, levelSumOfSquares, peak);
+        const float rms = static_cast<float>(std::sqrt(levelSumOfSquares / numSamples));
+
+        // End to end on the pool, at least three times and for at least
+        // minSeconds. Refilling the buffer isn't timed.
+        std::vector<double> iterations;
+        double totalNanoseconds = 0.0;
+        float hitRate = 0.0f;
+        while (iterations.size() < 3 || (totalNanoseconds < minSeconds * 1.0e9 && iterations.size() < 1000)) {
+            fillSignal(buffer, source, settings.signal);
+            const auto start = Time::getHighResolutionTicks();
+            processor.encryptAudioECB(buffer, keys[iterations.size() % 2], settings.numLevels, rms, peak, neverAbort);
+            const auto elapsed = ToolHelpers::ticksToNanoseconds(Time::getHighResolutionTicks() - start);
+            iterations.push_back(elapsed);
+            totalNanoseconds += elapsed;
+            hitRate += processor.getCodebookHitRate();
+            sampleResident();
+        }
+        hitRate /= static_cast<float>(iterations.size());
+        std::sort(iterations.begin(), iterations.end());
+        const double median = ToolHelpers::percentile(iterations, 0.5);
+
+        // Stage by stage on one lane
+        EncryptionPool::Lane lane;
+        HeapBlock<int16_t> aesCopy(static_cast<size_t>(EncryptionPool::chunkSamples));
+        StageTimes stages;
+        int stagePasses = 0;
+        for (double elapsed = 0.0; stagePasses < 3 || (elapsed < minSeconds * 1.0e9 && stagePasses < 1000); stagePasses++) {
+            fillSignal(buffer, source, settings.signal);
+            const auto start = Time::getHighResolutionTicks();
+            timeStages(buffer, keys[stagePasses % 2], settings.numLevels, lane, aesCopy, stages);
+            elapsed += ToolHelpers::ticksToNanoseconds(Time::getHighResolutionTicks() - start);
+            sampleResident();
+        }
+
+        auto* stageResults = new DynamicObject();
+        auto addStage = [&] (const char* name, double nanoseconds) {
+            auto* stage = new DynamicObject();
+            const double perPass = nanoseconds / stagePasses;
+            stage->setProperty("ms", perPass / 1.0e6);
+            stage->setProperty("nsPerSample", perPass / numSamples);
+            stage->setProperty("mbPerSecond", megabytes / (perPass / 1.0e9));
+            stageResults->setProperty(name, var(stage));
+        };
+        addStage("measure", stages.measure);
+        addStage("key", stages.key);
+        addStage("quantize", stages.quantize);
+        addStage("cipher", stages.cipher);
+        addStage("aes", stages.aes);
+        addStage("renormalize", stages.renormalize);
+        addStage("clip", stages.clip);
+
+        auto* run = new DynamicObject();
+        run->setProperty("lengthSeconds", settings.lengthSeconds);
+        run->setProperty("samples", numSamples);
+        run->setProperty("quantizeLevels", settings.numLevels);
+        run->setProperty("keyLength", settings.key.length());
+        run->setProperty("signal", getSignalName(settings.signal));
+        run->setProperty("kernels", EncryptionKernels::getImplementationName());
+        run->setProperty("threads", processor.getEncryptionThreads());
+        run->setProperty("iterations", static_cast<int>(iterations.size()));
+        run->setProperty("medianMs", median / 1.0e6);
+        run->setProperty("minMs", iterations.front() / 1.0e6);
+        run->setProperty("mbPerSecond", megabytes / (median / 1.0e9));
+        run->setProperty("realtimeFactor", settings.lengthSeconds / (median / 1.0e9));
+        run->setProperty("codebookHitRate", hitRate);
+        run->setProperty("singleLaneHitRate", stages.numBlocks > 0
+                         ? 1.0 - static_cast<double>(stages.numBlocksEncrypted) / static_cast<double>(stages.numBlocks)
+                         : 0.0);
+        run->setProperty("stages", var(stageResults));
+        run->setProperty("rssGrowthBytes", residentPeak - residentBefore);
+        return var(run);
+    }
+
+    std::vector<double> getLengths(double maxSeconds)
+    {
+        std::vector<double> lengths;
+        for (double seconds : { 1.0, 10.0, 60.0, 300.0, 1800.0 }) {
+            if (seconds <= maxSeconds) {
+                lengths.push_back(seconds);
+            }
+        }
+        return lengths;
+    }
+
+    const int quantizeLevels[] = { 2, 4, 8, 16, 32, 64 };
+
+    // Empty, shorter than a block, exactly the 32 bytes AES-256 uses, and
+    // longer (only the first 32 characters count)
+    const char* const keyVariants[] = { "", "DefaultKey123", "0123456789abcdef0123456789abcdef",
+                                        "a passphrase much longer than the thirty-two characters of an AES-256 key" };
+
+    const EncryptionKernels::Implementation kernelSets[] = {
+        EncryptionKernels::Implementation::scalar, EncryptionKernels::Implementation::sse2,
+        EncryptionKernels::Implementation::avx2, EncryptionKernels::Implementation::neon
+    };
+
+    // The baseline, then one axis varied at a time
+    std::vector<Settings> getOneAxisSweep(double maxSeconds)
+    {
+        const Settings baseline;
+        std::vector<Settings> sweep;
+
+        for (double seconds : getLengths(maxSeconds)) {
+            auto s = baseline;
+            s.lengthSeconds = seconds;
+            sweep.push_back(s);
+        }
+        for (int numLevels : quantizeLevels) {
+            if (numLevels != baseline.numLevels) {
+                auto s = baseline;
+                s.numLevels = numLevels;
+                sweep.push_back(s);
+            }
+        }
+        for (const char* key : keyVariants) {
+            if (baseline.key != key) {
+                auto s = baseline;
+                s.key = key;
+                sweep.push_back(s);
+            }
+        }
+        {
+            auto s = baseline;
+            s.signal = Signal::noise;
+            sweep.push_back(s);
+        }
+        for (auto kernels : kernelSets) {
+            auto s = baseline;
+            s.kernels = kernels;
+            sweep.push_back(s);
+        }
+
+        for (auto& s : sweep) {
+            s.lengthSeconds = jmin(s.lengthSeconds, maxSeconds);
+        }
+        return sweep;
+    }
+
+    std::vector<Settings> getFullSweep(double maxSeconds)
+    {
+        std::vector<Settings> sweep;
+        for (double seconds : getLengths(maxSeconds))
+            for (int numLevels : quantizeLevels)
+                for (const char* key : keyVariants)
+                    for (auto signal : { Signal::sample, Signal::noise })
+                        sweep.push_back({ seconds, numLevels, key, signal, EncryptionKernels::Implementation::automatic });
+        return sweep;
+    }
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    ScopedJuceInitialiser_GUI juceInitialiser;
+    ArgumentList args(argc, argv);
+
+    const auto sampleFile = ToolHelpers::resolveSample(args.containsOption("--sample")
+                                                       ? args.getValueForOption("--sample")
+                                                       : String("100 dry guitar.wav"));
+    const double maxSeconds = args.containsOption("--max-seconds") ? args.getValueForOption("--max-seconds").getDoubleValue() : 1800.0;
+    const double minTime = args.containsOption("--min-time") ? args.getValueForOption("--min-time").getDoubleValue() : 1.0;
+
+    Source source;
+    if (!readSample(sampleFile, source)) {
+        std::cerr << "Could not read " << sampleFile.getFullPathName() << std::endl;
+        return 1;
+    }
+
+    // Only used for its encryption pool; nothing is loaded into it, so the
+    // encryption worker stays idle
+    JUCECB processor;
+    const auto defaultKernels = EncryptionKernels::getImplementation();
+    const auto sweep = args.containsOption("--full") ? getFullSweep(maxSeconds) : getOneAxisSweep(maxSeconds);
+    Array<var> runs;
+
+    for (const auto& settings : sweep) {
+        const auto run = runBenchmark(processor, source, settings, minTime);
+        EncryptionKernels::setImplementation(defaultKernels);
+        if (run.isVoid()) {
+            continue; // Kernel set not supported here
+        }
+        runs.add(run);
+        std::cerr << settings.lengthSeconds << " s, " << settings.numLevels << " levels, "
+                  << getSignalName(settings.signal) << ", " << run["kernels"].toString() << ": "
+                  << static_cast<double>(run["mbPerSecond"]) << " MB/s" << std::endl;
+    }
+
+    auto* result = new DynamicObject();
+    result->setProperty("benchmark", "encryption");
+    result->setProperty("build", ToolHelpers::describeBuild());
+    result->setProperty("sample", sampleFile.getFileName());
+    result->setProperty("sampleRate", source.sampleRate);
+    result->setProperty("runs", runs);
+    result->setProperty("peakRssBytes", ToolHelpers::getPeakResidentBytes());
+
+    return ToolHelpers::writeJson(var(result), args) ? 0 : 1;
+}
@@ -0,0 +1,465 @@
+/*
+ ==============================================================================
+
+ Golden-output regression harness.
+
+ Re-renders the reference files in "Sound samples" and compares them with
+ the shipped ones. Each "100 dry <sound>.wav" is loaded as the source with
+ the default key, and the root note is played at wet/dry 0, 1 and 0.5 for
+ as long as the note sounds in "100 dry", "100 wet" and "50:50 mix".
+
+ The shipped files are stereo 24-bit bounces of notes played by hand, so
+ they can't be reproduced sample for sample. Against them each render is
+ aligned by cross-correlation and matched in gain, and it has to pass on
+ the spectral error: the RMS difference in dB between the log-magnitude
+ spectra, averaged over frames. The time-domain error is reported as well.
+
+ For an exact check, render goldens from a known good build with
+ --write-goldens=<dir> (32-bit float), then run later builds with
+ --goldens=<dir>. Those are compared sample for sample, without alignment
+ or gain matching, against --tolerance.
+
+ Usage:
+   GoldenRender [--key=<text>] [--quantize=<levels>] [--storage=float32|int16]
+                [--write-goldens=<dir>] [--goldens=<dir>] [--tolerance=<abs>]
+                [--spectral-tolerance=<dB>] [--output=<file.json>]
+
+ Exits with 1 if any case fails.
+
+ ==============================================================================
+ */
+
+#include "../ToolHelpers.h"
+#include <complex>
+
+namespace
+{
+    constexpr int blockSize = 512;
+    constexpr int rootNote = 69;              // Plays the sample at its own speed
+    constexpr float activeThreshold = 0.01f;  // -40 dBFS
+    constexpr int fftOrder = 11;
+    constexpr int fftSize = 1 << fftOrder;
+
+    struct Case
+    {
+        const char* sound;
+        const char* golden;
+        float wetDry;
+    };
+
+    const Case cases[] = {
+        { "sine", "100 dry", 0.0f }, { "sine", "100 wet", 1.0f }, { "sine", "50:50 mix", 0.5f },
+        { "square", "100 dry", 0.0f }, { "square", "100 wet", 1.0f }, { "square", "50:50 mix", 0.5f },
+        { "sawtooth", "100 dry", 0.0f }, { "sawtooth", "100 wet", 1.0f }, { "sawtooth", "50:50 mix", 0.5f },
+        { "guitar", "100 dry", 0.0f }, { "guitar", "100 wet", 1.0f }, { "guitar", "50:50 mix", 0.5f }
+    };
+
+    String getFileName(const Case& c)
+    {
+        return String(c.golden) + " " + c.sound + ".wav";
+    }
+
+    // Mean of all channels
+    bool readMono(const File& file, std::vector<float>& samples, double& sampleRate)
+    {
+        AudioFormatManager formatManager;
+        formatManager.registerBasicFormats();
+        std::unique_ptr<AudioFormatReader> reader(formatManager.createReaderFor(file));
+        if (reader == nullptr) {
+            return false;
+        }
+
+        const int numSamples = static_cast<int>(reader->lengthInSamples);
+        const int numChannels = static_cast<int>(reader->numChannels);
+        AudioBuffer<float> buffer(numChannels, numSamples);
+        reader->read(&buffer, 0, numSamples, 0, true, true);
+
+        samples.assign(static_cast<size_t>(numSamples), 0.0f);
+        for (int channel = 0; channel < numChannels; channel++) {
+            const float* data = buffer.getReadPointer(channel);
+            for (int i = 0; i < numSamples; i++) {
+                samples[static_cast<size_t>(i)] += data[i] / numChannels;
+            }
+        }
+        sampleRate = reader->sampleRate;
+        return true;
+    }
+
+    bool writeFloatWav(const File& file, const std::vector<float>& samples, double sampleRate)
+    {
+        file.deleteFile();
+        std::unique_ptr<FileOutputStream> stream(file.createOutputStream());
+        if (stream == nullptr) {
+            return false;
+        }
+
+        WavAudioFormat format;
+        std::unique_ptr<AudioFormatWriter> writer(format.createWriterFor(stream.get(), sampleRate, 1, 32, {}, 0));
+        if (writer == nullptr) {
+            return false;
+        }
+        stream.release(); // The writer owns it now
+
+        const float* channels[] = { samples.data() };
+        return writer->writeFromFloatArrays(channels, 1, static_cast<int>(samples.size()));
+    }
+
+    // First and last samples above activeThreshold, or false if silent
+    bool findActiveRange(const std::vector<float>& samples, int& start, int& end)
+    {
+        const auto isActive = [] (float v) { return std::abs(v) > activeThreshold; };
+        const auto first = std::find_if(samples.begin(), samples.end(), isActive);
+        if (first == samples.end()) {
+            return false;
+        }
+        const auto last = std::find_if(samples.rbegin(), samples.rend(), isActive);
+        start = static_cast<int>(first - samples.begin());
+        end = static_cast<int>(samples.rend() - last);
+        return true;
+    }
+
+    // Plays the root note from the first sample for noteLength samples
+    std::vector<float> render(JUCECB& processor, double sampleRate, int noteLength, int totalLength)
+    {
+        ToolHelpers::prepare(processor, sampleRate, blockSize);
+
+        const int numChannels = jmax(1, processor.getTotalNumOutputChannels());
+        AudioBuffer<float> buffer(numChannels, blockSize);
+        MidiBuffer midi;
+
+        // Let any crossfade to a newly encrypted sample finish first
+        for (int i = 0; i < roundToInt(sampleRate * 0.25) / blockSize + 1; i++) {
+            processor.processBlock(buffer, midi);
+        }
+
+        std::vector<float> output(static_cast<size_t>(totalLength), 0.0f);
+        for (int position = 0; position < totalLength; position += blockSize) {
+            midi.clear();
+            if (position == 0) {
+                midi.addEvent(MidiMessage::noteOn(1, rootNote, 1.0f), 0);
+            }
+            if (noteLength >= position && noteLength < position + blockSize) {
+                midi.addEvent(MidiMessage::noteOff(1, rootNote), noteLength - position);
+            }
+
+            buffer.clear();
+            processor.processBlock(buffer, midi);
+            const int length = jmin(blockSize, totalLength - position);
+            std::copy(buffer.getReadPointer(0), buffer.getReadPointer(0) + length, output.begin() + position);
+        }
+
+        processor.releaseResources();
+        return output;
+    }
+
+    // Offset to add to a render index to get the matching golden index,
+    // searched within maxLag of the onset difference
+    int findOffset(const std::vector<float>& rendered, int renderedStart,
+                   const std::vector<float>& golden, int goldenStart, int maxLag)
+    {
+        const int window = 8192;
+        const int guess = goldenStart - renderedStart;
+        int bestOffset = guess;
+        double bestScore = -std::numeric_limits<double>::infinity();
+
+        for (int offset = guess - maxLag; offset <= guess + maxLag; offset++) {
+            double score = 0.0;
+            for (int i = goldenStart; i < goldenStart + window; i++) {
+                const int j = i - offset;
+                if (i < static_cast<int>(golden.size()) && j >= 0 && j < static_cast<int>(rendered.size())) {
+                    score += static_cast<double>(golden[static_cast<size_t>(i)]) * rendered[static_cast<size_t>(j)];
+                }
+            }
+            if (score > bestScore) {
+                bestScore = score;
+                bestOffset = offset;
+            }
+        }
+        return bestOffset;
+    }
+
+    // In-place radix-2 FFT of fftSize points
+    void fft(std::vector<std::complex<double>>& data)
+    {
+        for (int i = 1, j = 0; i < fftSize; i++) {
+            int bit = fftSize >> 1;
+            for (; (j & bit) != 0; bit >>= 1) {
+                j ^= bit;
+            }
+            j ^= bit;
+            if (i < j) {
+                std::swap(data[static_cast<size_t>(i)], data[static_cast<size_t>(j)]);
+            }
+        }
+        for (int length = 2; length <= fftSize; length <<= 1) {
+            const auto step = std::polar(1.0, -MathConstants<double>::twoPi / length);
+            for (int start = 0; start < fftSize; start += length) {
+                std::complex<double> w(1.0);
+                for (int k = 0; k < length / 2; k++) {
+                    const auto even = data[static_cast<size_t>(start + k)];
+                    const auto odd = data[static_cast<size_t>(start + k + length / 2)] * w;
+                    data[static_cast<size_t>(start + k)] = even + odd;
+                    data[static_cast<size_t>(start + k + length / 2)] = even - odd;
+                    w *= step;
+                }
+            }
+        }
+    }
+
+    void magnitudeSpectrum(const float* frame, const std::vector<double>& window, std::vector<double>& magnitudes)
+    {
+        std::vector<std::complex<double>> bins(static_cast<size_t>(fftSize));
+        for (int i = 0; i < fftSize; i++) {
+            bins[static_cast<size_t>(i)] = frame[i] * window[static_cast<size_t>(i)];
+        }
+        fft(bins);
+        magnitudes.resize(static_cast<size_t>(fftSize / 2));
+        for (int i = 0; i < fftSize / 2; i++) {
+            magnitudes[static_cast<size_t>(i)] = std::abs(bins[static_cast<size_t>(i)]);
+        }
+    }
+
+    // Mean over frames of the RMS dB difference between the log-magnitude
+    // spectra. Only bins within 60 dB of the golden frame's peak count, and
+    // frames where the golden is below -60 dBFS are skipped.
+    double spectralError(const float* rendered, const float* golden, int numSamples)
+    {
+        std::vector<double> window(static_cast<size_t>(fftSize));
+        for (int i = 0; i < fftSize; i++) {
+            window[static_cast<size_t>(i)] = 0.5 - 0.5 * std::cos(MathConstants<double>::twoPi * i / fftSize);
+        }
+
+        std::vector<double> renderedSpectrum, goldenSpectrum;
+        double total = 0.0;
+        int numFrames = 0;
+
+        for (int start = 0; start + fftSize <= numSamples; start += fftSize / 2) {
+            double energy = 0.0;
+            for (int i = 0; i < fftSize; i++) {
+                energy += static_cast<double>(golden[start + i]) * golden[start + i];
+            }
+            if (std::sqrt(energy / fftSize) < 0.001) {
+                continue;
+            }
+
+            magnitudeSpectrum(rendered + start, window, renderedSpectrum);
+            magnitudeSpectrum(golden + start, window, goldenSpectrum);
+            const double floor = *std::max_element(goldenSpectrum.begin(), goldenSpectrum.end()) * 0.001;
+
+            double sumOfSquares = 0.0;
+            int numBins = 0;
+            for (size_t bin = 1; bin < goldenSpectrum.size(); bin++) {
+                if (goldenSpectrum[bin] >= floor) {
+                    const double difference = 20.0 * std::log10((renderedSpectrum[bin] + floor * 0.01)
+                                                                / (goldenSpectrum[bin] + floor * 0.01));
+                    sumOfSquares += difference * difference;
+                    numBins++;
+                }
+            }
+            if (numBins > 0) {
+                total += std::sqrt(sumOfSquares / numBins);
+                numFrames++;
+            }
+        }
+        return numFrames > 0 ? total / numFrames : 0.0;
+    }
+
+    struct Comparison
+    {
+        int offset = 0;
+        int numSamples = 0;
+        double gain = 1.0;
+        double maxError = 0.0;
+        double errorDb = -std::numeric_limits<double>::infinity(); // Error RMS relative to the golden's
+        double spectralErrorDb = 0.0;
+    };
+
+    Comparison compare(const std::vector<float>& rendered, const std::vector<float>& golden,
+                       int offset, int goldenStart, int goldenEnd, bool matchGain)
+    {
+        Comparison result;
+        result.offset = offset;
+
+        // The overlap of the golden's active range and the render
+        const int start = jmax(goldenStart, offset);
+        const int end = jmin(goldenEnd, offset + static_cast<int>(rendered.size()));
+        result.numSamples = jmax(0, end - start);
+        if (result.numSamples == 0) {
+            return result;
+        }
+
+        std::vector<float> aligned(rendered.begin() + (start - offset), rendered.begin() + (end - offset));
+        const float* target = golden.data() + start;
+
+        if (matchGain) {
+            double cross = 0.0, energy = 0.0;
+            for (int i = 0; i < result.numSamples; i++) {
+                cross += static_cast<double>(aligned[static_cast<size_t>(i)]) * target[i];
+                energy += static_cast<double>(aligned[static_cast<size_t>(i)]) * aligned[static_cast<size_t>(i)];
+            }
+            result.gain = energy > 0.0 ? cross / energy : 1.0;
+            for (auto& v : aligned) {
+                v = static_cast<float>(v * result.gain);
+            }
+        }
+
+        double errorSumOfSquares = 0.0, goldenSumOfSquares = 0.0;
+        for (int i = 0; i < result.numSamples; i++) {
+            const double error = static_cast<double>(aligned[static_cast<size_t>(i)]) - target[i];
+            result.maxError = jmax(result.maxError, std::abs(error));
+            errorSumOfSquares += error * error;
+            goldenSumOfSquares += static_cast<double>(target[i]) * target[i];
+        }
+        if (errorSumOfSquares > 0.0 && goldenSumOfSquares > 0.0) {
+            result.errorDb = 10.0 * std::log10(errorSumOfSquares / goldenSumOfSquares);
+        }
+        result.spectralErrorDb = spectralError(aligned.data(), target, result.numSamples);
+        return result;
+    }
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    ScopedJuceInitialiser_GUI juceInitialiser;
+    ArgumentList args(argc, argv);
+
+    const auto soundSamples = ToolHelpers::findSoundSamples();
+    if (!soundSamples.isDirectory()) {
+        std::cerr << "Could not find the Sound samples folder" << std::endl;
+        return 1;
+    }
+
+    const auto key = args.containsOption("--key") ? args.getValueForOption("--key") : String("DefaultKey123");
+    const int quantize = args.containsOption("--quantize") ? args.getValueForOption("--quantize").getIntValue() : 16;
+    const bool exact = args.containsOption("--goldens");
+    const auto goldenDirectory = exact ? File::getCurrentWorkingDirectory().getChildFile(args.getValueForOption("--goldens"))
+                                       : soundSamples;
+    const auto writeDirectory = args.containsOption("--write-goldens")
+                                ? File::getCurrentWorkingDirectory().getChildFile(args.getValueForOption("--write-goldens"))
+                                : File();
+    const double tolerance = args.containsOption("--tolerance") ? args.getValueForOption("--tolerance").getDoubleValue() : 1.0e-4;
+    const double spectralTolerance = args.containsOption("--spectral-tolerance")
+                                     ? args.getValueForOption("--spectral-tolerance").getDoubleValue()
+                                     : (exact ? 0.1 : 3.0);
+
+    if (writeDirectory != File()) {
+        writeDirectory.createDirectory();
+    }
+
+    Array<var> results;
+    bool allPassed = true;
+    String loadedSound;
+
+    // A fresh processor per sound, so each starts from the same state
+    std::unique_ptr<JUCECB> processor;
+
+    for (const auto& c : cases) {
+        auto* result = new DynamicObject();
+        result->setProperty("file", getFileName(c));
+        result->setProperty("wetDry", c.wetDry);
+        results.add(var(result));
+
+        auto fail = [&] (const String& reason) {
+            result->setProperty("passed", false);
+            result->setProperty("error", reason);
+            allPassed = false;
+            std::cerr << getFileName(c) << ": " << reason << std::endl;
+        };
+
+        if (loadedSound != c.sound) {
+            processor = std::make_unique<JUCECB>();
+            processor->setDiskCacheEnabled(false); // Always run the cipher
+            processor->setSampleStorage(args.getValueForOption("--storage") == "int16" ? SampleStorage::int16All
+                                                                                      : SampleStorage::float32);
+            processor->setEncryptionKey(key);
+            ToolHelpers::setParameter(*processor, "quantize", static_cast<float>(quantize));
+            ToolHelpers::setParameter(*processor, "loop", 1.0f);
+            loadedSound = c.sound;
+
+            if (!processor->loadFileAndWait(soundSamples.getChildFile(String("100 dry ") + c.sound + ".wav"))) {
+                loadedSound = {};
+                fail("could not load the source");
+                continue;
+            }
+        }
+
+        // The note is held for as long as it sounds in the shipped file
+        std::vector<float> shipped;
+        double sampleRate = 0.0;
+        int shippedStart = 0, shippedEnd = 0;
+        if (!readMono(soundSamples.getChildFile(getFileName(c)), shipped, sampleRate)
+            || !findActiveRange(shipped, shippedStart, shippedEnd)) {
+            fail("could not read the shipped file");
+            continue;
+        }
+
+        const auto* release = processor->parameters.getRawParameterValue("release");
+        const int releaseSamples = roundToInt(release->load() * sampleRate);
+        const int noteLength = jmax(blockSize, shippedEnd - shippedStart - releaseSamples);
+        const int totalLength = static_cast<int>(shipped.size());
+
+        ToolHelpers::setParameter(*processor, "wetdry", c.wetDry);
+        const auto rendered = render(*processor, sampleRate, noteLength, totalLength);
+
+        if (writeDirectory != File() && !writeFloatWav(writeDirectory.getChildFile(getFileName(c)), rendered, sampleRate)) {
+            fail("could not write the golden");
+            continue;
+        }
+
+        Comparison comparison;
+        if (exact) {
+            std::vector<float> golden;
+            double goldenRate = 0.0;
+            if (!readMono(goldenDirectory.getChildFile(getFileName(c)), golden, goldenRate) || goldenRate != sampleRate) {
+                fail("could not read the golden");
+                continue;
+            }
+            if (golden.size() != rendered.size()) {
+                fail("length differs from the golden");
+                continue;
+            }
+            comparison = compare(rendered, golden, 0, 0, static_cast<int>(golden.size()), false);
+        } else {
+            int renderedStart = 0, renderedEnd = 0;
+            if (!findActiveRange(rendered, renderedStart, renderedEnd)) {
+                fail("render is silent");
+                continue;
+            }
+            const int offset = findOffset(rendered, renderedStart, shipped, shippedStart, roundToInt(sampleRate * 0.02));
+            comparison = compare(rendered, shipped, offset, shippedStart, shippedEnd, true);
+        }
+
+        const bool passed = comparison.numSamples > 0
+                            && comparison.spectralErrorDb <= spectralTolerance
+                            && (!exact || comparison.maxError <= tolerance);
+
+        result->setProperty("passed", passed);
+        result->setProperty("offset", comparison.offset);
+        result->setProperty("comparedSamples", comparison.numSamples);
+        result->setProperty("gainDb", Decibels::gainToDecibels(comparison.gain, -200.0));
+        result->setProperty("maxError", comparison.maxError);
+        result->setProperty("errorDb", std::isfinite(comparison.errorDb) ? var(comparison.errorDb) : var(-200.0));
+        result->setProperty("spectralErrorDb", comparison.spectralErrorDb);
+        allPassed = allPassed && passed;
+
+        std::cerr << getFileName(c) << ": " << (passed ? "pass" : "FAIL")
+                  << ", spectral error " << comparison.spectralErrorDb << " dB"
+                  << ", max error " << comparison.maxError << std::endl;
+    }
+
+    auto* summary = new DynamicObject();
+    summary->setProperty("harness", "golden");
+    summary->setProperty("build", ToolHelpers::describeBuild());
+    summary->setProperty("mode", exact ? "exact" : "shipped");
+    summary->setProperty("goldens", goldenDirectory.getFullPathName());
+    summary->setProperty("keyLength", key.length());
+    summary->setProperty("quantize", quantize);
+    summary->setProperty("tolerance", tolerance);
+    summary->setProperty("spectralTolerance", spectralTolerance);
+    summary->setProperty("passed", allPassed);
+    summary->setProperty("cases", results);
+
+    const bool written = ToolHelpers::writeJson(var(summary), args);
+    return written && allPassed ? 0 : 1;
+}
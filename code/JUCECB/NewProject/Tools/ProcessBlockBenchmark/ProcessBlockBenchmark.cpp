@@ -0,0 +1,384 @@
+/*
+ ==============================================================================
+
+ Headless processBlock benchmark.
+
+ Loads a sample from "Sound samples" and drives JUCECB::processBlock with
+ scripted MIDI: chords, fast repeats, pitch-wheel sweeps and
+ voice-stealing storms. By default each workload runs at a baseline
+ setting and then varies block size, sample rate, voice count, loop and
+ wet/dry one at a time; --full runs every combination instead. The
+ liveInput workload then runs the live input effect on a synthetic input
+ signal over block sizes, sample rates and quantize levels. Every run
+ reports the cost per sample and per block, block time percentiles and the
+ realtime headroom; realtimeFactor is how many instances one core keeps up
+ with. The whole result is written as one JSON document so two builds can
+ be compared. In a JUCECB_TRACING build, --trace also dumps the stage
+ timings of the last runs as a Chrome trace.
+
+ Usage:
+   ProcessBlockBenchmark [--sample=<file>] [--seconds=<s>] [--full]
+                         [--workload=<name>] [--output=<file.json>]
+                         [--trace=<file.json>]
+
+ ==============================================================================
+ */
+
+#include "../ToolHelpers.h"
+
+namespace
+{
+    struct Settings
+    {
+        int blockSize = 256;
+        double sampleRate = 48000.0;
+        int voices = VoicePool::defaultPolyphony;
+        bool loop = true;
+        float wetDry = 0.5f;
+    };
+
+    // Fills the MIDI for one block. blockStart is in samples since the run
+    // started.
+    using Script = std::function<void (MidiBuffer& midi, juce::int64 blockStart, int numSamples, double sampleRate)>;
+
+    struct Workload
+    {
+        String name;
+        Script script;
+    };
+
+    struct LiveSettings
+    {
+        int blockSize = 256;
+        double sampleRate = 48000.0;
+        int quantize = 16;
+    };
+
+    const String liveWorkloadName = "liveInput";
+
+    // Runs processBlock for the warm-up and then seconds of audio, calling
+    // fillBlock(buffer, midi, position) before each block, and returns the
+    // measured block times in nanoseconds, sorted
+    template <typename FillBlock>
+    std::vector<double> timeBlocks(JUCECB& processor, int blockSize, double sampleRate, double seconds,
+                                   FillBlock&& fillBlock)
+    {
+        ToolHelpers::prepare(processor, sampleRate, blockSize);
+
+        const int numChannels = jmax(processor.getTotalNumInputChannels(), processor.getTotalNumOutputChannels());
+        AudioBuffer<float> buffer(numChannels, blockSize);
+        MidiBuffer midi;
+
+        const auto warmUpSamples = static_cast<juce::int64>(sampleRate * 0.5);
+        const auto totalSamples = warmUpSamples + static_cast<juce::int64>(sampleRate * seconds);
+        std::vector<double> blockNanoseconds;
+        blockNanoseconds.reserve(static_cast<size_t>(totalSamples / blockSize + 1));
+
+        for (juce::int64 position = 0; position < totalSamples; position += blockSize) {
+            midi.clear();
+            fillBlock(buffer, midi, position);
+
+            const auto start = Time::getHighResolutionTicks();
+            processor.processBlock(buffer, midi);
+            const auto elapsed = ToolHelpers::ticksToNanoseconds(Time::getHighResolutionTicks() - start);
+
+            if (position >= warmUpSamples) {
+                blockNanoseconds.push_back(elapsed);
+            }
+        }
+
+        processor.releaseResources();
+        std::sort(blockNanoseconds.begin(), blockNanoseconds.end());
+        return blockNanoseconds;
+    }
+
+    void addTimings(DynamicObject& run, const std::vector<double>& blockNanoseconds, int blockSize, double sampleRate)
+    {
+        // Headroom is the share of the block deadline left unused
+        const double deadlineNanoseconds = blockSize / sampleRate * 1.0e9;
+        const double totalNanoseconds = std::accumulate(blockNanoseconds.begin(), blockNanoseconds.end(), 0.0);
+        const double meanNanoseconds = totalNanoseconds / static_cast<double>(blockNanoseconds.size());
+
+        run.setProperty("blocks", static_cast<int>(blockNanoseconds.size()));
+        run.setProperty("nsPerSample", meanNanoseconds / blockSize);
+        run.setProperty("nsPerBlock", meanNanoseconds);
+        run.setProperty("blockMeanUs", meanNanoseconds / 1000.0);
+        run.setProperty("blockP50Us", ToolHelpers::percentile(blockNanoseconds, 0.5) / 1000.0);
+        run.setProperty("blockP90Us", ToolHelpers::percentile(blockNanoseconds, 0.9) / 1000.0);
+        run.setProperty("blockP99Us", ToolHelpers::percentile(blockNanoseconds, 0.99) / 1000.0);
+        run.setProperty("blockP999Us", ToolHelpers::percentile(blockNanoseconds, 0.999) / 1000.0);
+        run.setProperty("blockMaxUs", blockNanoseconds.back() / 1000.0);
+        run.setProperty("deadlineUs", deadlineNanoseconds / 1000.0);
+        run.setProperty("meanHeadroom", 1.0 - meanNanoseconds / deadlineNanoseconds);
+        run.setProperty("worstHeadroom", 1.0 - blockNanoseconds.back() / deadlineNanoseconds);
+        run.setProperty("realtimeFactor", deadlineNanoseconds / meanNanoseconds);
+    }
+
+    // Calls onEvent for every multiple of period that falls in the block
+    template <typename Callback>
+    void forEachTick(juce::int64 blockStart, int numSamples, juce::int64 period, Callback&& onEvent)
+    {
+        const juce::int64 first = (blockStart + period - 1) / period;
+        for (juce::int64 tick = first; tick * period < blockStart + numSamples; tick++) {
+            onEvent(tick, static_cast<int>(tick * period - blockStart));
+        }
+    }
+
+    std::vector<Workload> getWorkloads()
+    {
+        std::vector<Workload> workloads;
+
+        // Four-note chords every half second, released after 400 ms
+        workloads.push_back({ "chords", [] (MidiBuffer& midi, juce::int64 blockStart, int numSamples, double sampleRate) {
+            const auto period = static_cast<juce::int64>(sampleRate * 0.5);
+            const auto length = static_cast<juce::int64>(sampleRate * 0.4);
+            const int chord[] = { 0, 4, 7, 11 };
+            forEachTick(blockStart, numSamples, period, [&] (juce::int64 tick, int offset) {
+                const int root = 48 + static_cast<int>(tick % 12);
+                for (int interval : chord) {
+                    midi.addEvent(MidiMessage::noteOn(1, root + interval, 0.8f), offset);
+                }
+            });
+            forEachTick(blockStart - length, numSamples, period, [&] (juce::int64 tick, int offset) {
+                const int root = 48 + static_cast<int>(tick % 12);
+                for (int interval : chord) {
+                    midi.addEvent(MidiMessage::noteOff(1, root + interval), offset);
+                }
+            });
+        } });
+
+        // One note retriggered every 10 ms
+        workloads.push_back({ "fastRepeats", [] (MidiBuffer& midi, juce::int64 blockStart, int numSamples, double sampleRate) {
+            const auto period = jmax(juce::int64(2), static_cast<juce::int64>(sampleRate * 0.01));
+            forEachTick(blockStart, numSamples, period, [&] (juce::int64, int offset) {
+                midi.addEvent(MidiMessage::noteOff(1, 60), offset);
+                midi.addEvent(MidiMessage::noteOn(1, 60, 0.9f), offset);
+            });
+        } });
+
+        // A held triad under a continuous pitch-wheel sweep, one message per millisecond
+        workloads.push_back({ "pitchSweep", [] (MidiBuffer& midi, juce::int64 blockStart, int numSamples, double sampleRate) {
+            if (blockStart == 0) {
+                for (int note : { 57, 60, 64 }) {
+                    midi.addEvent(MidiMessage::noteOn(1, note, 0.8f), 0);
+                }
+            }
+            const auto period = jmax(juce::int64(1), static_cast<juce::int64>(sampleRate * 0.001));
+            forEachTick(blockStart, numSamples, period, [&] (juce::int64 tick, int offset) {
+                const double phase = static_cast<double>(tick * period) / sampleRate * MathConstants<double>::twoPi * 0.5;
+                const int wheel = jlimit(0, 16383, 8192 + roundToInt(std::sin(phase) * 8191.0));
+                midi.addEvent(MidiMessage::pitchWheel(1, wheel), offset);
+            });
+        } });
+
+        // Sixteen new notes every 5 ms and none released, so every note
+        // past the polyphony steals a voice
+        workloads.push_back({ "stealStorm", [] (MidiBuffer& midi, juce::int64 blockStart, int numSamples, double sampleRate) {
+            const auto period = jmax(juce::int64(1), static_cast<juce::int64>(sampleRate * 0.005));
+            forEachTick(blockStart, numSamples, period, [&] (juce::int64 tick, int offset) {
+                for (int i = 0; i < 16; i++) {
+                    midi.addEvent(MidiMessage::noteOn(1, 36 + static_cast<int>((tick * 16 + i) % 60), 0.7f), offset);
+                }
+            });
+        } });
+
+        return workloads;
+    }
+
+    var runBenchmark(JUCECB& processor, const Workload& workload, const Settings& settings, double seconds)
+    {
+        processor.setPolyphony(settings.voices);
+        ToolHelpers::setParameter(processor, "loop", settings.loop ? 1.0f : 0.0f);
+        ToolHelpers::setParameter(processor, "wetdry", settings.wetDry);
+
+        const auto blockNanoseconds = timeBlocks(processor, settings.blockSize, settings.sampleRate, seconds,
+                                                 [&] (AudioBuffer<float>&, MidiBuffer& midi, juce::int64 position) {
+            workload.script(midi, position, settings.blockSize, settings.sampleRate);
+        });
+
+        auto* run = new DynamicObject();
+        run->setProperty("workload", workload.name);
+        run->setProperty("blockSize", settings.blockSize);
+        run->setProperty("sampleRate", settings.sampleRate);
+        run->setProperty("voices", settings.voices);
+        run->setProperty("loop", settings.loop);
+        run->setProperty("wetDry", settings.wetDry);
+        addTimings(*run, blockNanoseconds, settings.blockSize, settings.sampleRate);
+        return var(run);
+    }
+
+    // Live input mode on a guitar-like test signal: a decaying harmonic
+    // tone plus a little noise, so the quantizer sees changing levels
+    var runLiveBenchmark(JUCECB& processor, const LiveSettings& settings, double seconds)
+    {
+        ToolHelpers::setParameter(processor, "live", 1.0f);
+        ToolHelpers::setParameter(processor, "quantize", static_cast<float>(settings.quantize));
+        ToolHelpers::setParameter(processor, "wetdry", 0.5f);
+        Random random(1);
+
+        const auto blockNanoseconds = timeBlocks(processor, settings.blockSize, settings.sampleRate, seconds,
+                                                 [&] (AudioBuffer<float>& buffer, MidiBuffer&, juce::int64 position) {
+            float* input = buffer.getWritePointer(0);
+            for (int i = 0; i < buffer.getNumSamples(); i++) {
+                const double t = static_cast<double>(position + i) / settings.sampleRate;
+                const double envelope = std::exp(-3.0 * std::fmod(t, 1.0));
+                const double phase = MathConstants<double>::twoPi * 196.0 * t;
+                input[i] = static_cast<float>(envelope * 0.4 * (std::sin(phase) + 0.5 * std::sin(2.0 * phase)))
+                           + (random.nextFloat() - 0.5f) * 0.02f;
+            }
+        });
+
+        ToolHelpers::setParameter(processor, "live", 0.0f);
+
+        auto* run = new DynamicObject();
+        run->setProperty("workload", liveWorkloadName);
+        run->setProperty("blockSize", settings.blockSize);
+        run->setProperty("sampleRate", settings.sampleRate);
+        run->setProperty("quantize", settings.quantize);
+        addTimings(*run, blockNanoseconds, settings.blockSize, settings.sampleRate);
+        return var(run);
+    }
+
+    // The baseline, then one axis varied at a time
+    std::vector<Settings> getOneAxisSweep()
+    {
+        const Settings baseline;
+        std::vector<Settings> sweep { baseline };
+
+        for (int blockSize : { 32, 64, 128, 512, 1024, 2048 }) {
+            auto s = baseline;
+            s.blockSize = blockSize;
+            sweep.push_back(s);
+        }
+        for (double sampleRate : { 44100.0, 96000.0, 192000.0 }) {
+            auto s = baseline;
+            s.sampleRate = sampleRate;
+            sweep.push_back(s);
+        }
+        for (int voices : { 1, 8, VoicePool::capacity }) {
+            auto s = baseline;
+            s.voices = voices;
+            sweep.push_back(s);
+        }
+        {
+            auto s = baseline;
+            s.loop = false;
+            sweep.push_back(s);
+        }
+        for (float wetDry : { 0.0f, 1.0f }) {
+            auto s = baseline;
+            s.wetDry = wetDry;
+            sweep.push_back(s);
+        }
+        return sweep;
+    }
+
+    std::vector<LiveSettings> getLiveSweep(bool full)
+    {
+        std::vector<LiveSettings> sweep;
+        if (full) {
+            for (int blockSize : { 32, 64, 128, 256, 512, 1024, 2048 })
+                for (double sampleRate : { 44100.0, 48000.0, 96000.0, 192000.0 })
+                    for (int quantize : { 2, 16, 64 })
+                        sweep.push_back({ blockSize, sampleRate, quantize });
+            return sweep;
+        }
+
+        const LiveSettings baseline;
+        sweep.push_back(baseline);
+        for (int blockSize : { 16, 32, 64, 128, 512, 1024, 2048 }) {
+            auto s = baseline;
+            s.blockSize = blockSize;
+            sweep.push_back(s);
+        }
+        for (double sampleRate : { 44100.0, 96000.0, 192000.0 }) {
+            auto s = baseline;
+            s.sampleRate = sampleRate;
+            sweep.push_back(s);
+        }
+        for (int quantize : { 2, 64 }) {
+            auto s = baseline;
+            s.quantize = quantize;
+            sweep.push_back(s);
+        }
+        return sweep;
+    }
+
+    std::vector<Settings> getFullSweep()
+    {
+        std::vector<Settings> sweep;
+        for (int blockSize : { 32, 64, 128, 256, 512, 1024, 2048 })
+            for (double sampleRate : { 44100.0, 48000.0, 96000.0 })
+                for (int voices : { 1, 4, 8, VoicePool::capacity })
+                    for (bool loop : { true, false })
+                        for (float wetDry : { 0.0f, 0.5f, 1.0f })
+                            sweep.push_back({ blockSize, sampleRate, voices, loop, wetDry });
+        return sweep;
+    }
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    ScopedJuceInitialiser_GUI juceInitialiser;
+    ArgumentList args(argc, argv);
+
+    const auto sampleFile = ToolHelpers::resolveSample(args.containsOption("--sample")
+                                                       ? args.getValueForOption("--sample")
+                                                       : String("100 dry guitar.wav"));
+    const double seconds = args.containsOption("--seconds") ? args.getValueForOption("--seconds").getDoubleValue() : 5.0;
+    const auto onlyWorkload = args.getValueForOption("--workload");
+
+    JUCECB processor;
+    if (!sampleFile.existsAsFile() || !processor.loadFileAndWait(sampleFile)) {
+        std::cerr << "Could not load " << sampleFile.getFullPathName() << std::endl;
+        return 1;
+    }
+
+    const auto sweep = args.containsOption("--full") ? getFullSweep() : getOneAxisSweep();
+    Array<var> runs;
+
+    for (const auto& workload : getWorkloads()) {
+        if (onlyWorkload.isNotEmpty() && workload.name != onlyWorkload) {
+            continue;
+        }
+        for (const auto& settings : sweep) {
+            runs.add(runBenchmark(processor, workload, settings, seconds));
+            std::cerr << workload.name << " block " << settings.blockSize << " @ " << settings.sampleRate
+                      << " Hz, " << settings.voices << " voices: "
+                      << static_cast<double>(runs.getLast()["nsPerSample"]) << " ns/sample" << std::endl;
+        }
+    }
+
+    if (onlyWorkload.isEmpty() || onlyWorkload == liveWorkloadName) {
+        // Feed the optional live input bus, as a host would in live mode
+        processor.enableAllBuses();
+        for (const auto& settings : getLiveSweep(args.containsOption("--full"))) {
+            runs.add(runLiveBenchmark(processor, settings, seconds));
+            std::cerr << liveWorkloadName << " block " << settings.blockSize << " @ " << settings.sampleRate
+                      << " Hz, quantize " << settings.quantize << ": "
+                      << static_cast<double>(runs.getLast()["nsPerBlock"]) << " ns/block, "
+                      << static_cast<double>(runs.getLast()["realtimeFactor"]) << "x realtime" << std::endl;
+        }
+    }
+
+    if (args.containsOption("--trace")) {
+        const auto traceFile = File::getCurrentWorkingDirectory().getChildFile(args.getValueForOption("--trace"));
+        if (!Tracing::isCompiledIn()) {
+            std::cerr << "Built without JUCECB_TRACING, the trace will be empty" << std::endl;
+        }
+        if (!processor.writeTrace(traceFile)) {
+            std::cerr << "Could not write " << traceFile.getFullPathName() << std::endl;
+            return 1;
+        }
+    }
+
+    auto* result = new DynamicObject();
+    result->setProperty("benchmark", "processBlock");
+    result->setProperty("build", ToolHelpers::describeBuild());
+    result->setProperty("sample", sampleFile.getFileName());
+    result->setProperty("secondsPerRun", seconds);
+    result->setProperty("runs", runs);
+
+    return ToolHelpers::writeJson(var(result), args) ? 0 : 1;
+}
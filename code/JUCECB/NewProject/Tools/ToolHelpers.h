@@ -0,0 +1,144 @@
+/*
+ ==============================================================================
+
+ Helpers shared by the headless tools in this directory.
+
+ The tools link the plugin's shared code and drive a JUCECB instance
+ directly, with no host and no message loop. See Builds/LinuxMakefile/Tools.mk.
+
+ ==============================================================================
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+
+#if JUCE_LINUX || JUCE_MAC
+ #include <sys/resource.h>
+#endif
+
+#if JUCE_LINUX
+ #include <unistd.h>
+#elif JUCE_MAC
+ #include <mach/mach.h>
+#endif
+
+//==============================================================================
+struct ToolHelpers
+{
+    // The "Sound samples" folder shipped next to the project, searched for
+    // upwards from the working directory and from the executable
+    static File findSoundSamples()
+    {
+        for (auto start : { File::getCurrentWorkingDirectory(),
+                            File::getSpecialLocation(File::currentExecutableFile) }) {
+            for (auto dir = start; dir != dir.getParentDirectory(); dir = dir.getParentDirectory()) {
+                for (auto candidate : { dir.getChildFile("Sound samples"),
+                                        dir.getChildFile("JUCECB").getChildFile("Sound samples") }) {
+                    if (candidate.isDirectory()) {
+                        return candidate;
+                    }
+                }
+            }
+        }
+        return {};
+    }
+
+    // Resolves a --sample style argument: a path, or a file name inside
+    // the "Sound samples" folder
+    static File resolveSample(const String& nameOrPath)
+    {
+        if (File::isAbsolutePath(nameOrPath)) {
+            return File(nameOrPath);
+        }
+        const auto relative = File::getCurrentWorkingDirectory().getChildFile(nameOrPath);
+        return relative.existsAsFile() ? relative : findSoundSamples().getChildFile(nameOrPath);
+    }
+
+    static void prepare(JUCECB& processor, double sampleRate, int blockSize)
+    {
+        processor.setRateAndBufferSizeDetails(sampleRate, blockSize);
+        processor.prepareToPlay(sampleRate, blockSize);
+    }
+
+    // Sets a parameter in its natural range, like a host would
+    static void setParameter(JUCECB& processor, const String& parameterID, float value)
+    {
+        if (auto* parameter = processor.parameters.getParameter(parameterID)) {
+            parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+        }
+    }
+
+    static double ticksToNanoseconds(juce::int64 ticks)
+    {
+        return static_cast<double>(ticks) * 1.0e9 / static_cast<double>(Time::getHighResolutionTicksPerSecond());
+    }
+
+    // Percentile of already sorted values, p in [0, 1]
+    static double percentile(const std::vector<double>& sorted, double p)
+    {
+        if (sorted.empty()) {
+            return 0.0;
+        }
+        const auto index = static_cast<size_t>(jlimit(0.0, 1.0, p) * static_cast<double>(sorted.size() - 1) + 0.5);
+        return sorted[index];
+    }
+
+    // Current resident set size of this process, or 0 if unknown
+    static juce::int64 getResidentBytes()
+    {
+       #if JUCE_LINUX
+        const auto fields = StringArray::fromTokens(File("/proc/self/statm").loadFileAsString(), " ", {});
+        return fields.size() > 1 ? fields[1].getLargeIntValue() * sysconf(_SC_PAGESIZE) : 0;
+       #elif JUCE_MAC
+        mach_task_basic_info info {};
+        mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+        return task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count)
+                   == KERN_SUCCESS ? static_cast<juce::int64>(info.resident_size) : 0;
+       #else
+        return 0;
+       #endif
+    }
+
+    // Peak resident set size of this process so far, or 0 if unknown
+    static juce::int64 getPeakResidentBytes()
+    {
+       #if JUCE_LINUX
+        rusage usage {};
+        return getrusage(RUSAGE_SELF, &usage) == 0 ? juce::int64(usage.ru_maxrss) * 1024 : 0;
+       #elif JUCE_MAC
+        rusage usage {};
+        return getrusage(RUSAGE_SELF, &usage) == 0 ? juce::int64(usage.ru_maxrss) : 0;
+       #else
+        return 0;
+       #endif
+    }
+
+    static var describeBuild()
+    {
+        auto* build = new DynamicObject();
+        build->setProperty("compiled", String(__DATE__) + " " + String(__TIME__));
+       #if JUCE_DEBUG
+        build->setProperty("config", "Debug");
+       #else
+        build->setProperty("config", "Release");
+       #endif
+        build->setProperty("renderer", VoiceRenderer::getImplementationName());
+        build->setProperty("cpu", SystemStats::getCpuModel());
+        build->setProperty("cores", SystemStats::getNumCpus());
+        return var(build);
+    }
+
+    // Writes JSON to the file named by --output, or to stdout
+    static bool writeJson(const var& result, const ArgumentList& args)
+    {
+        const auto json = JSON::toString(result);
+        if (args.containsOption("--output")) {
+            const auto file = File::getCurrentWorkingDirectory().getChildFile(args.getValueForOption("--output"));
+            return file.replaceWithText(json + "\n");
+        }
+        std::cout << json << std::endl;
+        return true;
+    }
+};